@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Minimal microbenchmark harness shared by the Bench executables.
+ * A case runs once to warm caches and lazy state up, then repetitions times; every repetition is timed as a whole
+ * and divided by the number of items it processed. The median is reported since it is not dragged by the odd
+ * preempted run, min and max are kept to show the spread.
+ */
+namespace Bench{
+    struct Result{
+        std::string name;
+        uint32_t items = 0; // Items processed by one repetition
+        uint32_t repetitions = 0;
+        double median_ns = 0.0; // Per item
+        double min_ns = 0.0;
+        double max_ns = 0.0;
+    };
+
+    // Times repetitions runs of func, each processing items items
+    template<typename Func>
+    Result measure(const std::string &name, uint32_t items, uint32_t repetitions, Func &&func)
+    {
+        if(items == 0 || repetitions == 0){
+            throw std::runtime_error("Benchmark needs at least one item and one repetition: " + name);
+        }
+        func(); // Warm-up
+
+        std::vector<double> samples;
+        samples.reserve(repetitions);
+        for(uint32_t i = 0; i < repetitions; i++){
+            auto start = std::chrono::high_resolution_clock::now();
+            func();
+            samples.push_back(std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / items);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        Result result;
+        result.name = name;
+        result.items = items;
+        result.repetitions = repetitions;
+        result.median_ns = samples[samples.size() / 2];
+        result.min_ns = samples.front();
+        result.max_ns = samples.back();
+        return result;
+    }
+
+    // Reads a positive item count from value into count, false when it is not one
+    inline bool parseCount(const char * value, uint32_t &count)
+    {
+        uint32_t parsed = 0;
+        auto [end, error] = std::from_chars(value, value + std::strlen(value), parsed);
+        if(error != std::errc() || *end != '\0' || parsed == 0){
+            std::cerr << "Expected a positive item count, got \"" << value << "\"" << std::endl;
+            return false;
+        }
+        count = parsed;
+        return true;
+    }
+
+    // Prints one line per result
+    inline void print(const std::vector<Result> &results)
+    {
+        for(const Result &result : results){
+            std::cout << std::left << std::setw(36) << result.name << std::right << std::fixed << std::setprecision(1)
+                      << std::setw(12) << result.median_ns << " ns/item (min " << result.min_ns << ", max " << result.max_ns
+                      << ", " << result.items << " items x " << result.repetitions << ")" << std::endl;
+        }
+        std::cout.unsetf(std::ios::floatfield);
+    }
+
+    // Writes the results as a JSON array, one object per case. Names must not need escaping
+    inline bool writeJSON(const std::string &path, const std::vector<Result> &results)
+    {
+        std::ofstream file(path, std::ios::trunc);
+        if(!file.is_open()){
+            std::cout << "Failed to write benchmark results: " << path << std::endl;
+            return false;
+        }
+
+        file << std::fixed << std::setprecision(3) << "[";
+        for(size_t i = 0; i < results.size(); i++){
+            const Result &result = results[i];
+            file << (i == 0 ? "" : ",") << "\n  {\"name\":\"" << result.name << "\",\"items\":" << result.items
+                 << ",\"repetitions\":" << result.repetitions << ",\"median_ns\":" << result.median_ns
+                 << ",\"min_ns\":" << result.min_ns << ",\"max_ns\":" << result.max_ns << "}";
+        }
+        file << "\n]\n";
+
+        std::cout << "Written benchmark results to: " << path << std::endl;
+        return true;
+    }
+}
@@ -0,0 +1,236 @@
+#include "../VulkanEngine/device.hpp"
+#include "../VulkanEngine/memory.hpp"
+#include "../VulkanEngine/frameallocator.hpp"
+#include "../VulkanEngine/pipeline.hpp"
+#include "../VulkanEngine/camera.hpp"
+#include "../VulkanEngine/gameobject.hpp"
+#include "bench.hpp"
+
+#include <random>
+#include <sstream>
+
+// Microbenchmarks of the engine hot paths. The Vulkan cases need no window: a headless device is created on the
+// best GPU, or on lavapipe when the loader is pointed at it (VK_DRIVER_FILES=.../lvp_icd.x86_64.json)
+
+namespace{
+    // Headless Vulkan objects needed by the cases, destroyed in reverse order
+    struct BenchContext{
+        vk::raii::Context context;
+        vk::raii::Instance instance = nullptr;
+        vk::raii::PhysicalDevice physical_device = nullptr;
+        vk::raii::Device logical_device = nullptr;
+        QueuePool queue_pool;
+        VmaAllocator vma_allocator = nullptr;
+
+        void create()
+        {
+            constexpr vk::ApplicationInfo app_info{
+                "Engine Bench",
+                VK_MAKE_VERSION(1, 0, 0),
+                "Engine Title",
+                VK_MAKE_VERSION(1, 0, 0),
+                vk::ApiVersion13
+            };
+            vk::InstanceCreateInfo create_info({}, &app_info);
+            instance = vk::raii::Instance(context, create_info);
+
+            physical_device = Device::pickPhysicalDevice(instance);
+            vk::raii::SurfaceKHR surface = nullptr; // Headless, the graphics queue stands in for present
+            logical_device = Device::createLogicalDevice(physical_device, surface, queue_pool);
+
+            queue_pool.graphics_queue = vk::raii::Queue(logical_device, queue_pool.graphics_family.value(), 0);
+            queue_pool.transfer_queue = vk::raii::Queue(logical_device, queue_pool.transfer_family.value(), 0);
+            queue_pool.transfer_command_pool = Device::createCommandPool(logical_device, vk::CommandPoolCreateFlagBits::eTransient, queue_pool.transfer_family.value());
+
+            vma_allocator = MemoryAllocator::createMemoryAllocator(physical_device, logical_device, instance);
+        }
+
+        void destroy()
+        {
+            queue_pool.transfer_command_pool = nullptr;
+            if(vma_allocator){
+                vmaDestroyAllocator(vma_allocator);
+                vma_allocator = nullptr;
+            }
+        }
+    };
+
+    // Sends std::cout nowhere while alive, the buffer destructors log every destruction
+    class MuteOutput{
+    public:
+        MuteOutput() : previous(std::cout.rdbuf(sink.rdbuf())) {}
+        ~MuteOutput() { std::cout.rdbuf(previous); }
+
+    private:
+        std::ostringstream sink;
+        std::streambuf * previous;
+    };
+
+    const uint32_t REPETITIONS = 31;
+
+    void benchTransforms(std::vector<Bench::Result> &results, uint32_t count)
+    {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> position(-100.f, 100.f), angle(-360.f, 360.f), scale(0.5f, 2.f);
+
+        // A speed makes update mark the model dirty, with dtime 0 nothing actually moves
+        std::vector<Gameobject> objects;
+        objects.reserve(count);
+        for(uint32_t i = 0; i < count; i++){
+            objects.emplace_back(glm::vec3(position(rng), position(rng), position(rng)), glm::vec3(scale(rng)),
+                                 glm::vec3(angle(rng), angle(rng), angle(rng)), glm::vec3(1.f));
+        }
+
+        glm::mat4 sink(0.f);
+        results.push_back(Bench::measure("Gameobject::getModelMat dirty", count, REPETITIONS, [&](){
+            for(Gameobject &object : objects){
+                object.update(0.f);
+                sink += object.getModelMat();
+            }
+        }));
+        results.push_back(Bench::measure("Gameobject::getModelMat cached", count, REPETITIONS, [&](){
+            for(Gameobject &object : objects){
+                sink += object.getModelMat();
+            }
+        }));
+
+        Camera camera(glm::vec3(0.f, 2.f, 8.f));
+        results.push_back(Bench::measure("Camera::getViewMatrix", count, REPETITIONS, [&](){
+            for(uint32_t i = 0; i < count; i++){
+                sink += camera.getViewMatrix();
+            }
+        }));
+        results.push_back(Bench::measure("Camera::getProjectionMatrix", count, REPETITIONS, [&](){
+            for(uint32_t i = 0; i < count; i++){
+                sink += camera.getProjectionMatrix(16.f / 9.f);
+            }
+        }));
+
+        volatile float keep = sink[0][0]; // Keeps the loops from being optimized out
+        (void)keep;
+    }
+
+    void benchDescriptors(std::vector<Bench::Result> &results, BenchContext &vulkan)
+    {
+        const int frames = vulkan.queue_pool.max_frames_in_flight;
+        const uint32_t updates = 256;
+
+        std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+            vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eUniformBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex, nullptr),
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBufferDynamic, 1, vk::ShaderStageFlagBits::eVertex, nullptr)
+        };
+        vk::raii::DescriptorSetLayout layout = PipelineBuilder::createDescriptorSetLayout(bindings, vulkan.logical_device);
+        vk::raii::DescriptorPool pool = PipelineBuilder::createDescriptorPool(bindings, vulkan.logical_device, frames);
+        std::vector<vk::raii::DescriptorSet> sets = PipelineBuilder::createDescriptorSets(layout, pool, vulkan.logical_device, frames);
+
+        FrameAllocator allocator;
+        vk::DeviceSize alignment = FrameAllocator::getRequiredAlignment(vulkan.physical_device);
+        allocator.create(1 << 16, frames, vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer, alignment, vulkan.vma_allocator);
+
+        vk::DescriptorBufferInfo camera_info = allocator.getDescriptorInfo(sizeof(UniformBufferCamera));
+        vk::DescriptorBufferInfo objects_info = allocator.getDescriptorInfo(1 << 12);
+        std::vector<void *> resources = {&camera_info, &objects_info};
+
+        results.push_back(Bench::measure("PipelineBuilder::writeDescriptorSets", updates, REPETITIONS, [&](){
+            for(uint32_t i = 0; i < updates; i++){
+                PipelineBuilder::writeDescriptorSets(sets, bindings, resources, vulkan.logical_device, frames);
+            }
+        }));
+
+        MuteOutput mute;
+        allocator.destroy();
+    }
+
+    void benchBuffers(std::vector<Bench::Result> &results, BenchContext &vulkan, uint32_t object_count)
+    {
+        const int frames = vulkan.queue_pool.max_frames_in_flight;
+        const uint32_t buffers = 64;
+        const vk::DeviceSize ubo_size = sizeof(UniformBufferCamera);
+
+        FrameAllocator allocator;
+        vk::DeviceSize alignment = FrameAllocator::getRequiredAlignment(vulkan.physical_device);
+        vk::DeviceSize frame_size = FrameAllocator::alignUp(ubo_size, alignment) * buffers +
+                                    FrameAllocator::alignUp(sizeof(glm::mat4) * object_count, alignment);
+        {
+            MuteOutput mute;
+            allocator.create(frame_size, frames, vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer,
+                             alignment, vulkan.vma_allocator);
+        }
+
+        // What a per-object uniform buffer costs against a slice of the frame allocator
+        {
+            MuteOutput mute;
+            results.push_back(Bench::measure("Device::createBuffer + destroy (UBO)", buffers, REPETITIONS, [&](){
+                for(uint32_t i = 0; i < buffers; i++){
+                    AllocatedBuffer buffer = Device::createBuffer(ubo_size, vk::BufferUsageFlagBits::eUniformBuffer,
+                        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, "bench ubo", vulkan.vma_allocator);
+                }
+            }));
+        }
+        int frame = 0;
+        results.push_back(Bench::measure("FrameAllocator::allocate (UBO)", buffers, REPETITIONS, [&](){
+            allocator.beginFrame(frame);
+            frame = (frame + 1) % frames;
+            for(uint32_t i = 0; i < buffers; i++){
+                allocator.allocate(ubo_size);
+            }
+        }));
+
+        // Per-frame upload of updateUniformBuffers: camera plus one model matrix per object
+        std::vector<glm::mat4> models(object_count, glm::mat4(1.f));
+        UniformBufferCamera ubo_camera{glm::mat4(1.f), glm::mat4(1.f)};
+        results.push_back(Bench::measure("UBO memcpy per frame (per object)", object_count, REPETITIONS, [&](){
+            allocator.beginFrame(frame);
+            frame = (frame + 1) % frames;
+            FrameAllocation camera_allocation = allocator.allocate(sizeof(UniformBufferCamera));
+            memcpy(camera_allocation.data, &ubo_camera, sizeof(UniformBufferCamera));
+            FrameAllocation objects_allocation = allocator.allocate(sizeof(glm::mat4) * object_count);
+            glm::mat4 * mapped = static_cast<glm::mat4 *>(objects_allocation.data);
+            for(uint32_t i = 0; i < object_count; i++){
+                memcpy(mapped + i, &models[i], sizeof(glm::mat4));
+            }
+        }));
+
+        // Staging to device local copy, submitted and waited on like at load time
+        const vk::DeviceSize copy_size = 1 << 20;
+        const uint32_t copies = 8;
+        MuteOutput mute;
+        AllocatedBuffer staging = Device::createBuffer(copy_size, vk::BufferUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, "bench staging", vulkan.vma_allocator);
+        AllocatedBuffer destination = Device::createBuffer(copy_size, vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, "bench destination", vulkan.vma_allocator);
+        results.push_back(Bench::measure("Device::copyBuffer (1 MiB)", copies, REPETITIONS, [&](){
+            for(uint32_t i = 0; i < copies; i++){
+                Device::copyBuffer(staging, destination, copy_size, vulkan.logical_device, vulkan.queue_pool, 0);
+            }
+        }));
+
+        allocator.destroy();
+    }
+}
+
+int main(int argc, char * argv[]){
+    uint32_t count = 10000;
+    if(argc > 1 && !Bench::parseCount(argv[1], count)){
+        return EXIT_FAILURE;
+    }
+    const std::string output = argc > 2 ? argv[2] : "bench_results.json";
+
+    std::vector<Bench::Result> results;
+    benchTransforms(results, count);
+
+    BenchContext vulkan;
+    try{
+        vulkan.create();
+        benchDescriptors(results, vulkan);
+        benchBuffers(results, vulkan, count);
+    }
+    catch(const std::exception &error){
+        std::cout << "Vulkan cases skipped: " << error.what() << std::endl;
+    }
+    vulkan.destroy();
+
+    std::cout << "\nEngine microbenchmarks (median of " << REPETITIONS << " runs after a warm-up)" << std::endl;
+    Bench::print(results);
+    return Bench::writeJSON(output, results) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,60 @@
+#include "../VulkanEngine/systems.hpp"
+#include "../VulkanEngine/transforms.hpp"
+#include "bench.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+// Microbenchmark of the model matrix paths: per-object glm calls against the batched Transforms kernels
+
+int main(int argc, char * argv[]){
+    uint32_t count = 100000;
+    if(argc > 1 && !Bench::parseCount(argv[1], count)){
+        return EXIT_FAILURE;
+    }
+    const uint32_t repetitions = 51;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> position(-100.f, 100.f), angle(-360.f, 360.f), scale(0.5f, 2.f);
+    std::vector<Transform> transforms(count);
+    Transforms::TRSBatch batch;
+    for(Transform &transform : transforms){
+        transform.position = glm::vec3(position(rng), position(rng), position(rng));
+        transform.rotation = glm::vec3(angle(rng), angle(rng), angle(rng));
+        transform.scale = glm::vec3(scale(rng), scale(rng), scale(rng));
+        batch.push(transform.position, transform.rotation, transform.scale);
+    }
+
+    std::vector<glm::mat4> reference(count), scalar(count), simd(count);
+    std::vector<Transforms::Affine3x4> affine(count);
+
+    double glm_time = Bench::measure("glm", count, repetitions, [&](){
+        for(uint32_t i = 0; i < count; i++){
+            reference[i] = Systems::computeModelMatrix(transforms[i]);
+        }
+    }).median_ns;
+    double scalar_time = Bench::measure("scalar", count, repetitions, [&](){
+        Transforms::computeModelMatricesScalar(batch, 0, count, reinterpret_cast<float *>(scalar.data()), 16);
+    }).median_ns;
+    double simd_time = Bench::measure("simd", count, repetitions, [&](){
+        Transforms::computeModelMatrices(batch, simd.data());
+    }).median_ns;
+    double affine_time = Bench::measure("affine", count, repetitions, [&](){
+        Transforms::computeModelMatrices(batch, affine.data());
+    }).median_ns;
+
+    float max_error = 0.f;
+    for(uint32_t i = 0; i < count; i++){
+        for(int column = 0; column < 4; column++){
+            glm::vec4 difference = glm::abs(reference[i][column] - simd[i][column]);
+            max_error = std::max(max_error, std::max(std::max(difference.x, difference.y), std::max(difference.z, difference.w)));
+        }
+    }
+
+    std::cout << "Model matrices: " << count << " (median of " << repetitions << " runs)"
+              << "\nglm translate/rotate/scale: " << glm_time << " ns/matrix"
+              << "\nClosed form scalar:         " << scalar_time << " ns/matrix"
+              << "\nClosed form best (4x4):     " << simd_time << " ns/matrix" << (Transforms::supportsAVX2() ? " (AVX2)" : " (no AVX2, scalar)")
+              << "\nClosed form best (3x4):     " << affine_time << " ns/matrix"
+              << "\nMax error against glm:      " << max_error << std::endl;
+}
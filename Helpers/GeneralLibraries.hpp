@@ -45,6 +45,10 @@ struct QueuePool {
     vk::raii::CommandBuffers graphics_command_buffers = nullptr;
     int max_frames_in_flight = 2;
 
+    // Per frame in flight and per recording thread: a transient pool, reset as a whole every frame, and its secondary buffer
+    std::vector<std::vector<vk::raii::CommandPool>> secondary_command_pools;
+    std::vector<std::vector<vk::raii::CommandBuffer>> secondary_command_buffers;
+
     bool isIndexComplete() const{
         return graphics_family.has_value() && 
             present_family.has_value() &&
@@ -186,8 +190,7 @@ struct RasterPipelineBundle{
     vk::raii::DescriptorPool descriptor_pool = nullptr;
     std::vector<vk::raii::DescriptorSet> descriptor_sets;
 
-    std::vector<vk::PipelineShaderStageCreateInfo> shader_stages = {};
-    std::vector<vk::raii::ShaderModule> shaders = {};
+    std::vector<vk::PipelineShaderStageCreateInfo> shader_stages = {}; // Modules owned by the ShaderLibrary
 
     vk::PipelineInputAssemblyStateCreateInfo input_assembly = {};
     vk::PipelineRasterizationStateCreateInfo rasterizer = {};
@@ -262,6 +265,28 @@ struct RasterPipelineBundle{
     }
 };
 
+// Struct that holds all the information about a compute pipeline
+struct ComputePipelineBundle{
+    std::string name = "default compute pipeline name";
+    vk::raii::Pipeline pipeline = nullptr;
+    vk::raii::DescriptorSetLayout descriptor_set_layout = nullptr;
+    vk::raii::PipelineLayout layout = nullptr;
+    vk::raii::DescriptorPool descriptor_pool = nullptr;
+    std::vector<vk::raii::DescriptorSet> descriptor_sets;
+
+    std::vector<vk::PushConstantRange> push_constant_ranges = {};
+
+    ComputePipelineBundle() = default;
+
+    // Disable copying to prevent double-free
+    ComputePipelineBundle(const ComputePipelineBundle&) = delete;
+    ComputePipelineBundle& operator=(const ComputePipelineBundle&) = delete;
+
+    // Enable moving
+    ComputePipelineBundle(ComputePipelineBundle&& other) noexcept = default;
+    ComputePipelineBundle& operator=(ComputePipelineBundle&& other) noexcept = default;
+};
+
 // Structure that holds all info about Vertices
 struct Vertex{
     glm::vec3 position;
@@ -387,6 +412,27 @@ struct UniformBufferGameObjects{
     }
 };
 
+// Indirect draw handled by the culling compute pass. Starts with the indexed indirect command so the array can be
+// consumed directly by drawIndexedIndirectCount with sizeof(CullDraw) as stride. Mirrors CullDraw in cull.comp
+struct CullDraw{
+    vk::DrawIndexedIndirectCommand command; // instanceCount is filled by the GPU
+    uint32_t padding[3] = {0, 0, 0};
+    glm::vec4 local_sphere = glm::vec4(0.f); // Bounding sphere of the mesh: center xyz, radius w
+};
+static_assert(sizeof(CullDraw) == 48, "CullDraw must match the std430 layout of cull.comp");
+
+// Push constants of the culling compute pass
+struct CullPushConstants{
+    glm::vec4 planes[6]; // Frustum planes, a point is inside when dot(plane.xyz, p) + plane.w >= 0
+    uint32_t object_count;
+};
+
+// Push constants of the raster pipelines: device addresses of the draw's data. Mirrors DrawParams in vertex.vert
+struct DrawPushConstants{
+    vk::DeviceAddress camera = 0; // UniformBufferCamera of the frame
+    vk::DeviceAddress objects = 0; // Model matrices, indexed with gl_InstanceIndex
+};
+
 // Uniform Buffer object for mapped data
 struct MappedUBO{
     AllocatedBuffer buffer;
@@ -419,6 +465,18 @@ struct MappedUBO{
 };
 
 
+// FNV-1a hash of size bytes. seed chains several calls, it defaults to the FNV offset basis
+inline uint64_t hashFNV1a(const void *data, size_t size, uint64_t seed = 0xcbf29ce484222325ull){
+    const uint8_t * bytes = static_cast<const uint8_t *>(data);
+    uint64_t hash = seed;
+    for(size_t i = 0; i < size; i++){
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+
 enum class InputState{
     PRESSED,
     RELEASED,
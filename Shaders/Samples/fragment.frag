@@ -7,5 +7,10 @@ layout(location = 10) in vec3 fragColor;
 layout(location = 0) out vec4 outColor;
 
 void main(){
+#ifdef SHOW_DEPTH
+    // Depth buffer view, compiled as a define variant by the ShaderLibrary
+    outColor = vec4(vec3(gl_FragCoord.z), 1.0);
+#else
     outColor = vec4(fragColor, 1.0);
+#endif
 }
\ No newline at end of file
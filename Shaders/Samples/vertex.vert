@@ -1,4 +1,5 @@
 #version 450
+#extension GL_EXT_buffer_reference : require
 
 // Locations defined by Vertex struct
 layout(location = 0) in vec3 inPosition;
@@ -8,16 +9,24 @@ layout(location = 2) in vec3 inColor;
 // Output locations (to fragment shader)
 layout(location = 10) out vec3 fragColor;
 
-layout(binding = 0) uniform UniformBufferCamera {
+// Per-frame data, reached through device addresses. Allocations are at least 16 byte aligned
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer CameraData{
     mat4 view;
     mat4 proj;
-} cam_ubo;
+};
 
-layout(binding = 1) uniform UniformBufferGameObject{
-    mat4 model;
-}object_ubo;
+// One model matrix per instance
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer ObjectData{
+    mat4 models[];
+};
+
+// Mirrors DrawPushConstants in GeneralLibraries.hpp
+layout(push_constant) uniform DrawParams{
+    CameraData camera;
+    ObjectData objects;
+}params;
 
 void main(){
-    gl_Position = cam_ubo.proj * cam_ubo.view * object_ubo.model * vec4(inPosition, 1.0);
+    gl_Position = params.camera.proj * params.camera.view * params.objects.models[gl_InstanceIndex] * vec4(inPosition, 1.0);
     fragColor = inColor;
-}
\ No newline at end of file
+}
@@ -10,6 +10,31 @@ glm::mat4 Camera::getProjectionMatrix(float aspect_ratio, float near_plane, floa
     return glm::perspective(glm::radians(zoom), aspect_ratio, near_plane, far_plane);
 }
 
+std::array<glm::vec4, 6> Camera::getFrustumPlanes(float aspect_ratio, float near_plane, float far_plane) const
+{
+    // Planes are extracted from the rows of the view-projection matrix (glm matrices are column major)
+    glm::mat4 view_proj = getProjectionMatrix(aspect_ratio, near_plane, far_plane) * getViewMatrix();
+    glm::vec4 rows[4];
+    for(int i = 0; i < 4; i++){
+        rows[i] = glm::vec4(view_proj[0][i], view_proj[1][i], view_proj[2][i], view_proj[3][i]);
+    }
+
+    std::array<glm::vec4, 6> planes = {
+        rows[3] + rows[0], // left
+        rows[3] - rows[0], // right
+        rows[3] + rows[1], // bottom
+        rows[3] - rows[1], // top
+        rows[3] + rows[2], // near
+        rows[3] - rows[2]  // far
+    };
+
+    for(glm::vec4 &plane : planes){
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    return planes;
+}
+
 void Camera::processKeyboard(CameraMovement direction, float dtime)
 {
     float velocity = max_speed * dtime;
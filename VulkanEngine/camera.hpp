@@ -32,6 +32,9 @@ public:
     glm::mat4 getViewMatrix() const;
     glm::mat4 getProjectionMatrix(float aspect_ratio, float near_plane = 0.1f, float far_plane = 100.f) const;
 
+    // Normalized frustum planes (left, right, bottom, top, near, far) in world space, pointing inwards
+    std::array<glm::vec4, 6> getFrustumPlanes(float aspect_ratio, float near_plane = 0.1f, float far_plane = 100.f) const;
+
     // Input procesing methods for different interaction modalities
     virtual void processKeyboard(CameraMovement direction, float dtime);
     void processMouseMovement(float x_offset, float y_offset, bool constrain_pitch = true);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include "meshregistry.hpp"
+
+// Components of the engine entities. Each one holds only what a system needs, so systems stream through small arrays
+
+// Spatial information. Rotation is in degrees, applied X then Y then Z
+struct Transform{
+    glm::vec3 position = glm::vec3(0.f);
+    glm::vec3 rotation = glm::vec3(0.f);
+    glm::vec3 scale = glm::vec3(1.f);
+    bool dirty = true; // The model matrix and world bounds need to follow
+};
+
+// Change per millisecond of each Transform field
+struct Velocity{
+    glm::vec3 linear = glm::vec3(0.f);
+    glm::vec3 angular = glm::vec3(0.f);
+    glm::vec3 scale = glm::vec3(0.f);
+};
+
+// Model matrix built from Transform
+struct ModelMatrix{
+    glm::mat4 model = glm::mat4(1.f);
+};
+
+// Bounding sphere (center xyz, radius w) and box of the mesh, in local space and after the model matrix
+struct Bounds{
+    glm::vec4 local_sphere = glm::vec4(0.f);
+    glm::vec4 world_sphere = glm::vec4(0.f);
+    glm::vec3 local_min = glm::vec3(0.f);
+    glm::vec3 local_max = glm::vec3(0.f);
+    glm::vec3 world_min = glm::vec3(0.f);
+    glm::vec3 world_max = glm::vec3(0.f);
+};
+
+// Geometry the entity is drawn with
+struct MeshComponent{
+    MeshHandle mesh;
+};
+
+enum RenderFlags : uint32_t{
+    RENDER_VISIBLE = 1 << 0, // Hidden entities are neither culled nor drawn
+};
+
+// How the entity is drawn
+struct RenderInfo{
+    uint32_t draw = 0; // Raster pipeline drawing the entity
+    uint32_t flags = RENDER_VISIBLE;
+};
@@ -0,0 +1,148 @@
+#include "cpuprofiler.hpp"
+
+#include <mutex>
+#include <memory>
+#include <iomanip>
+
+namespace{
+    // Event slot. Relaxed atomics, so the exporter can read a slot the owner is rewriting without a data race
+    struct Slot{
+        std::atomic<const char *> name{nullptr};
+        std::atomic<uint64_t> start_ns{0};
+        std::atomic<uint64_t> duration_ns{0};
+    };
+
+    // Ring of one thread. Only the owner writes, head counts every zone ever recorded
+    struct ThreadRing{
+        std::unique_ptr<Slot[]> slots = std::make_unique<Slot[]>(Profiler::RING_SIZE);
+        std::atomic<uint64_t> head{0};
+        uint32_t thread_id = 0;
+        std::string name;
+    };
+
+    // Rings outlive their threads, so a trace can still show the zones of a finished thread
+    std::mutex registry_mutex;
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+
+    const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+    thread_local std::shared_ptr<ThreadRing> thread_ring; // Created by the first zone of the thread
+    thread_local std::string thread_name;
+
+    ThreadRing &threadRing()
+    {
+        if(!thread_ring){
+            thread_ring = std::make_shared<ThreadRing>();
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            thread_ring -> thread_id = static_cast<uint32_t>(rings.size());
+            thread_ring -> name = thread_name.empty() ? "thread " + std::to_string(thread_ring -> thread_id) : thread_name;
+            rings.push_back(thread_ring);
+        }
+        return *thread_ring;
+    }
+
+    // Escapes the characters JSON does not allow inside a string
+    std::string escapeJSON(const std::string &text)
+    {
+        std::string escaped;
+        for(char c : text){
+            if(c == '"' || c == '\\'){
+                escaped += '\\';
+            }
+            escaped += (static_cast<unsigned char>(c) < 0x20) ? ' ' : c;
+        }
+        return escaped;
+    }
+}
+
+namespace Profiler{
+    std::atomic<bool> enabled{false};
+
+    void setEnabled(bool value)
+    {
+        enabled.store(value, std::memory_order_relaxed);
+    }
+
+    uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void record(const char *name, uint64_t start_ns, uint64_t end_ns)
+    {
+        ThreadRing &ring = threadRing();
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        Slot &slot = ring.slots[head % RING_SIZE];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start_ns.store(start_ns, std::memory_order_relaxed);
+        slot.duration_ns.store(end_ns - start_ns, std::memory_order_relaxed);
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    void setThreadName(const std::string &name)
+    {
+        // Threads that never record a zone do not get a ring
+        thread_name = name;
+        if(thread_ring){
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            thread_ring -> name = name;
+        }
+    }
+
+    bool writeChromeTrace(const std::string &path)
+    {
+        std::ofstream file(path, std::ios::trunc);
+        if(!file.is_open()){
+            std::cout << "Failed to write trace: " << path << std::endl;
+            return false;
+        }
+
+        std::vector<std::shared_ptr<ThreadRing>> snapshot;
+        std::vector<std::string> names;
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            snapshot = rings;
+            for(const std::shared_ptr<ThreadRing> &ring : rings){
+                names.push_back(ring -> name);
+            }
+        }
+
+        file << std::fixed << std::setprecision(3); // Microseconds with nanosecond digits
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        uint64_t total_events = 0;
+        std::vector<Event> events;
+        for(size_t i = 0; i < snapshot.size(); i++){
+            ThreadRing &ring = *snapshot[i];
+
+            file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring.thread_id
+                 << ",\"args\":{\"name\":\"" << escapeJSON(names[i]) << "\"}}";
+            first = false;
+
+            // Copy the newest zones, then drop the ones the owner may have overwritten meanwhile
+            uint64_t head = ring.head.load(std::memory_order_acquire);
+            uint64_t begin = head > RING_SIZE ? head - RING_SIZE : 0;
+            events.clear();
+            for(uint64_t index = begin; index < head; index++){
+                const Slot &slot = ring.slots[index % RING_SIZE];
+                events.push_back(Event{slot.name.load(std::memory_order_relaxed), slot.start_ns.load(std::memory_order_relaxed),
+                                       slot.duration_ns.load(std::memory_order_relaxed)});
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t new_head = ring.head.load(std::memory_order_relaxed);
+            uint64_t overwritten = new_head + 1 > RING_SIZE ? new_head + 1 - RING_SIZE : 0; // + 1: the slot being written now
+            size_t skip = overwritten > begin ? static_cast<size_t>(std::min(overwritten - begin, head - begin)) : 0;
+
+            for(size_t e = skip; e < events.size(); e++){
+                const Event &event = events[e];
+                file << ",\n{\"name\":\"" << escapeJSON(event.name) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring.thread_id
+                     << ",\"ts\":" << event.start_ns / 1000.0 << ",\"dur\":" << event.duration_ns / 1000.0 << "}";
+                total_events++;
+            }
+        }
+        file << "\n]}\n";
+
+        std::cout << "Written " << total_events << " profiler zones to: " << path << std::endl;
+        return true;
+    }
+}
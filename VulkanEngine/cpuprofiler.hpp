@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include <atomic>
+
+/**
+ * Scoped-zone CPU profiler.
+ * Each thread records its zones into a ring buffer of its own: the owner is the only writer and publishes with an
+ * atomic index, so recording takes no lock. When profiling is off a zone costs one relaxed load and a branch;
+ * building with -DCPU_PROFILER_DISABLED removes the zones entirely. The recorded zones are exported as Chrome
+ * trace_event JSON (chrome://tracing, Perfetto).
+ */
+namespace Profiler{
+    const uint32_t RING_SIZE = 1 << 16; // Zones kept per thread, the oldest are overwritten
+
+    // One finished zone
+    struct Event{
+        const char * name; // Must outlive the profiler (a string literal)
+        uint64_t start_ns;
+        uint64_t duration_ns;
+    };
+
+    extern std::atomic<bool> enabled;
+
+    inline bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool value);
+
+    // Nanoseconds since the profiler was first used
+    uint64_t now();
+
+    // Appends a zone to the ring of the calling thread
+    void record(const char *name, uint64_t start_ns, uint64_t end_ns);
+
+    // Name shown for the calling thread in the trace
+    void setThreadName(const std::string &name);
+
+    // Writes every zone still in the rings as Chrome trace JSON. Safe while other threads keep recording
+    bool writeChromeTrace(const std::string &path);
+
+    // Zone covering its own lifetime
+    class Zone{
+    public:
+        explicit Zone(const char *name) : name(isEnabled() ? name : nullptr), start_ns(this -> name ? now() : 0) {}
+        ~Zone() { if(name) record(name, start_ns, now()); }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+    private:
+        const char * name;
+        uint64_t start_ns;
+    };
+}
+
+#define PROFILER_CONCAT_IMPL(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_IMPL(a, b)
+
+#ifndef CPU_PROFILER_DISABLED
+// Profiles the rest of the enclosing scope under name
+#define PROFILE_ZONE(name) Profiler::Zone PROFILER_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
@@ -0,0 +1,144 @@
+#include "culling.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CULLING_X86
+#endif
+
+uint32_t Culling::cullSpheres(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, std::vector<uint32_t> &out_visible)
+{
+    uint32_t count = spheres.size();
+    out_visible.resize(count);
+
+    uint32_t visible = 0;
+    if(supportsAVX()){
+        visible = cullSpheresAVX(spheres, planes, 0, count, out_visible.data());
+    }
+    else{
+        visible = cullSpheresSSE(spheres, planes, 0, count, out_visible.data());
+    }
+
+    out_visible.resize(visible);
+    return visible;
+}
+
+uint32_t Culling::cullSpheresScalar(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, uint32_t begin, uint32_t end, uint32_t *out)
+{
+    uint32_t visible = 0;
+    for(uint32_t i = begin; i < end; i++){
+        bool inside = true;
+        for(const glm::vec4 &plane : planes){
+            float distance = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+            if(distance < -spheres.radius[i]){
+                inside = false;
+                break;
+            }
+        }
+        if(inside){
+            out[visible++] = i;
+        }
+    }
+    return visible;
+}
+
+#ifdef CULLING_X86
+
+uint32_t Culling::cullSpheresSSE(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, uint32_t begin, uint32_t end, uint32_t *out)
+{
+    // Broadcast every plane component once
+    __m128 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+    for(int p = 0; p < 6; p++){
+        plane_x[p] = _mm_set1_ps(planes[p].x);
+        plane_y[p] = _mm_set1_ps(planes[p].y);
+        plane_z[p] = _mm_set1_ps(planes[p].z);
+        plane_w[p] = _mm_set1_ps(planes[p].w);
+    }
+
+    uint32_t visible = 0;
+    uint32_t i = begin;
+    for(; i + 4 <= end; i += 4){
+        __m128 x = _mm_loadu_ps(&spheres.x[i]);
+        __m128 y = _mm_loadu_ps(&spheres.y[i]);
+        __m128 z = _mm_loadu_ps(&spheres.z[i]);
+        __m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&spheres.radius[i]));
+
+        // A sphere survives when it is in front of (or crossing) every plane
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for(int p = 0; p < 6; p++){
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane_x[p], x), _mm_mul_ps(plane_y[p], y)),
+                                         _mm_add_ps(_mm_mul_ps(plane_z[p], z), plane_w[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_radius));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        while(mask){
+            out[visible++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+
+    return visible + cullSpheresScalar(spheres, planes, i, end, out + visible);
+}
+
+__attribute__((target("avx")))
+uint32_t Culling::cullSpheresAVX(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, uint32_t begin, uint32_t end, uint32_t *out)
+{
+    __m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+    for(int p = 0; p < 6; p++){
+        plane_x[p] = _mm256_set1_ps(planes[p].x);
+        plane_y[p] = _mm256_set1_ps(planes[p].y);
+        plane_z[p] = _mm256_set1_ps(planes[p].z);
+        plane_w[p] = _mm256_set1_ps(planes[p].w);
+    }
+
+    uint32_t visible = 0;
+    uint32_t i = begin;
+    for(; i + 8 <= end; i += 8){
+        __m256 x = _mm256_loadu_ps(&spheres.x[i]);
+        __m256 y = _mm256_loadu_ps(&spheres.y[i]);
+        __m256 z = _mm256_loadu_ps(&spheres.z[i]);
+        __m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&spheres.radius[i]));
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for(int p = 0; p < 6; p++){
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(plane_x[p], x), _mm256_mul_ps(plane_y[p], y)),
+                                            _mm256_add_ps(_mm256_mul_ps(plane_z[p], z), plane_w[p]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_radius, _CMP_GE_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(inside);
+        while(mask){
+            out[visible++] = i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+
+    // Leftovers go through the 4-wide kernel
+    return visible + cullSpheresSSE(spheres, planes, i, end, out + visible);
+}
+
+bool Culling::supportsAVX()
+{
+    static const bool supported = __builtin_cpu_supports("avx");
+    return supported;
+}
+
+#else
+
+// Non x86 builds only have the scalar kernel
+uint32_t Culling::cullSpheresSSE(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, uint32_t begin, uint32_t end, uint32_t *out)
+{
+    return cullSpheresScalar(spheres, planes, begin, end, out);
+}
+
+uint32_t Culling::cullSpheresAVX(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, uint32_t begin, uint32_t end, uint32_t *out)
+{
+    return cullSpheresScalar(spheres, planes, begin, end, out);
+}
+
+bool Culling::supportsAVX()
+{
+    return false;
+}
+
+#endif
\ No newline at end of file
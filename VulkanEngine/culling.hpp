@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+namespace Culling{
+    // Bounding spheres stored as a structure of arrays, so the plane tests can load several spheres at once
+    struct SphereBatch{
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> radius;
+
+        void clear(){
+            x.clear();
+            y.clear();
+            z.clear();
+            radius.clear();
+        }
+
+        // Adds a sphere packed as center xyz, radius w
+        void push(const glm::vec4 &sphere){
+            x.push_back(sphere.x);
+            y.push_back(sphere.y);
+            z.push_back(sphere.z);
+            radius.push_back(sphere.w);
+        }
+
+        // Makes room for count spheres, written in place by index
+        void resize(uint32_t count){
+            x.resize(count);
+            y.resize(count);
+            z.resize(count);
+            radius.resize(count);
+        }
+
+        void set(uint32_t index, const glm::vec4 &sphere){
+            x[index] = sphere.x;
+            y[index] = sphere.y;
+            z[index] = sphere.z;
+            radius[index] = sphere.w;
+        }
+
+        uint32_t size() const{
+            return static_cast<uint32_t>(x.size());
+        }
+    };
+
+    // Visible and culled counts of a frame
+    struct Stats{
+        uint32_t visible = 0;
+        uint32_t culled = 0;
+    };
+
+    // Tests every sphere against the frustum planes (see Camera::getFrustumPlanes). Fills out_visible with the indices
+    // of the spheres that are at least partially inside and returns their count. Uses the widest kernel the CPU supports
+    uint32_t cullSpheres(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, std::vector<uint32_t> &out_visible);
+
+    // Kernels testing the spheres in [begin, end). They write the visible indices to out and return how many were written
+    uint32_t cullSpheresScalar(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, uint32_t begin, uint32_t end, uint32_t *out);
+    uint32_t cullSpheresSSE(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, uint32_t begin, uint32_t end, uint32_t *out); // 4 spheres at a time
+    uint32_t cullSpheresAVX(const SphereBatch &spheres, const std::array<glm::vec4, 6> &planes, uint32_t begin, uint32_t end, uint32_t *out); // 8 spheres at a time
+
+    // Returns whether the AVX kernel can run on this CPU
+    bool supportsAVX();
+}
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "descriptorheap.hpp"
+
+void DescriptorHeap::create(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &logical_device, Timeline &timeline,
+                            const HeapCapacities &capacities)
+{
+    this -> logical_device = &logical_device;
+    this -> timeline = &timeline;
+
+    auto properties = physical_device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+    const vk::PhysicalDeviceVulkan12Properties &limits = properties.get<vk::PhysicalDeviceVulkan12Properties>();
+    get(HeapArray::STORAGE_BUFFERS).capacity = std::min({capacities.storage_buffers,
+        limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers});
+    get(HeapArray::SAMPLED_IMAGES).capacity = std::min({capacities.sampled_images,
+        limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSampledImages});
+    get(HeapArray::SAMPLERS).capacity = std::min({capacities.samplers,
+        limits.maxPerStageDescriptorUpdateAfterBindSamplers, limits.maxDescriptorSetUpdateAfterBindSamplers});
+
+    // Every array is read by any stage. Unwritten slots are fine as long as shaders do not index them
+    const vk::ShaderStageFlags stages = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment | vk::ShaderStageFlagBits::eCompute;
+    std::array<vk::DescriptorSetLayoutBinding, static_cast<size_t>(HeapArray::COUNT)> bindings = {
+        vk::DescriptorSetLayoutBinding(static_cast<uint32_t>(HeapArray::STORAGE_BUFFERS), vk::DescriptorType::eStorageBuffer,
+                                       get(HeapArray::STORAGE_BUFFERS).capacity, stages, nullptr),
+        vk::DescriptorSetLayoutBinding(static_cast<uint32_t>(HeapArray::SAMPLED_IMAGES), vk::DescriptorType::eSampledImage,
+                                       get(HeapArray::SAMPLED_IMAGES).capacity, stages, nullptr),
+        vk::DescriptorSetLayoutBinding(static_cast<uint32_t>(HeapArray::SAMPLERS), vk::DescriptorType::eSampler,
+                                       get(HeapArray::SAMPLERS).capacity, stages, nullptr)
+    };
+    vk::DescriptorBindingFlags binding_flag = vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+                                              vk::DescriptorBindingFlagBits::eUpdateUnusedWhilePending |
+                                              vk::DescriptorBindingFlagBits::ePartiallyBound;
+    std::array<vk::DescriptorBindingFlags, static_cast<size_t>(HeapArray::COUNT)> binding_flags;
+    binding_flags.fill(binding_flag);
+
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info(binding_flags);
+    vk::DescriptorSetLayoutCreateInfo layout_info(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, bindings);
+    layout_info.pNext = &binding_flags_info;
+    layout = vk::raii::DescriptorSetLayout(logical_device, layout_info);
+
+    std::array<vk::DescriptorPoolSize, static_cast<size_t>(HeapArray::COUNT)> pool_sizes = {
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, get(HeapArray::STORAGE_BUFFERS).capacity),
+        vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, get(HeapArray::SAMPLED_IMAGES).capacity),
+        vk::DescriptorPoolSize(vk::DescriptorType::eSampler, get(HeapArray::SAMPLERS).capacity)
+    };
+    vk::DescriptorPoolCreateInfo pool_info(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind | vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+                                           1, pool_sizes);
+    pool = vk::raii::DescriptorPool(logical_device, pool_info);
+
+    vk::DescriptorSetAllocateInfo alloc_info(*pool, 1, &*layout);
+    set = std::move(logical_device.allocateDescriptorSets(alloc_info).front());
+
+    std::cout << "Descriptor heap: " << get(HeapArray::STORAGE_BUFFERS).capacity << " storage buffers, "
+              << get(HeapArray::SAMPLED_IMAGES).capacity << " sampled images, " << get(HeapArray::SAMPLERS).capacity << " samplers" << std::endl;
+}
+
+uint32_t DescriptorHeap::addStorageBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range)
+{
+    uint32_t slot = allocate(HeapArray::STORAGE_BUFFERS);
+    updateStorageBuffer(slot, buffer, offset, range);
+    return slot;
+}
+
+uint32_t DescriptorHeap::addSampledImage(vk::ImageView image_view, vk::ImageLayout layout)
+{
+    uint32_t slot = allocate(HeapArray::SAMPLED_IMAGES);
+    vk::DescriptorImageInfo image_info(nullptr, image_view, layout);
+    write(HeapArray::SAMPLED_IMAGES, slot, nullptr, &image_info);
+    return slot;
+}
+
+uint32_t DescriptorHeap::addSampler(vk::Sampler sampler)
+{
+    uint32_t slot = allocate(HeapArray::SAMPLERS);
+    vk::DescriptorImageInfo image_info(sampler, nullptr, vk::ImageLayout::eUndefined);
+    write(HeapArray::SAMPLERS, slot, nullptr, &image_info);
+    return slot;
+}
+
+void DescriptorHeap::updateStorageBuffer(uint32_t slot, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range)
+{
+    vk::DescriptorBufferInfo buffer_info(buffer, offset, range);
+    write(HeapArray::STORAGE_BUFFERS, slot, &buffer_info, nullptr);
+}
+
+void DescriptorHeap::release(HeapArray array, uint32_t slot, TimelinePoint last_use)
+{
+    get(array).retired_slots.emplace_back(last_use, slot);
+}
+
+void DescriptorHeap::update()
+{
+    for(SlotArray &slots : arrays){
+        for(size_t i = 0; i < slots.retired_slots.size();){
+            if(timeline -> isComplete(slots.retired_slots[i].first)){
+                slots.free_slots.push_back(slots.retired_slots[i].second);
+                slots.retired_slots[i] = slots.retired_slots.back();
+                slots.retired_slots.pop_back();
+            }
+            else{
+                i++;
+            }
+        }
+    }
+}
+
+void DescriptorHeap::destroy()
+{
+    set = nullptr;
+    pool = nullptr;
+    layout = nullptr;
+    for(SlotArray &slots : arrays){
+        slots = SlotArray();
+    }
+    logical_device = nullptr;
+    timeline = nullptr;
+}
+
+uint32_t DescriptorHeap::allocate(HeapArray array)
+{
+    SlotArray &slots = get(array);
+    if(!slots.free_slots.empty()){
+        uint32_t slot = slots.free_slots.back();
+        slots.free_slots.pop_back();
+        return slot;
+    }
+    if(slots.next >= slots.capacity){
+        throw std::runtime_error("Descriptor heap array is full!");
+    }
+    return slots.next++;
+}
+
+void DescriptorHeap::write(HeapArray array, uint32_t slot, const vk::DescriptorBufferInfo *buffer_info, const vk::DescriptorImageInfo *image_info)
+{
+    static const vk::DescriptorType types[] = {vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eSampledImage, vk::DescriptorType::eSampler};
+
+    vk::WriteDescriptorSet write(*set, static_cast<uint32_t>(array), slot, 1, types[static_cast<size_t>(array)], image_info, buffer_info, nullptr);
+    logical_device -> updateDescriptorSets(write, nullptr);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+#include "timeline.hpp"
+
+// Arrays of the heap, the value is the binding of the array in the heap set
+enum class HeapArray : uint32_t{
+    STORAGE_BUFFERS,
+    SAMPLED_IMAGES,
+    SAMPLERS,
+    COUNT
+};
+
+// Number of descriptors reserved per array. Clamped to the update-after-bind limits of the device
+struct HeapCapacities{
+    uint32_t storage_buffers = 1024;
+    uint32_t sampled_images = 4096;
+    uint32_t samplers = 64;
+};
+
+/**
+ * Engine-wide bindless descriptor set.
+ * One update-after-bind set with an array of storage buffers, one of sampled images and one of samplers, bound once
+ * as set 0 of every raster pipeline. Resources are written into a slot of their array and shaders index the array
+ * with the slot, passed through push constants. A slot keeps its index until released, and is only handed out again
+ * once the graphics submission that could still read it is done, so frames in flight never see it change.
+ */
+class DescriptorHeap{
+public:
+    void create(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &logical_device, Timeline &timeline,
+                const HeapCapacities &capacities = {});
+
+    // Each returns the slot the resource was written to. Throws when the array is full
+    uint32_t addStorageBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range);
+    uint32_t addSampledImage(vk::ImageView image_view, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+    uint32_t addSampler(vk::Sampler sampler);
+
+    // Points an existing slot at another buffer. Only valid when no submission in flight reads the slot
+    void updateStorageBuffer(uint32_t slot, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range);
+
+    // Gives slot back once last_use is reached, timeline.last(QueueType::GRAPHICS) when drawn up to now
+    void release(HeapArray array, uint32_t slot, TimelinePoint last_use);
+
+    // Recycles the released slots whose last use is done. Called once per frame
+    void update();
+
+    vk::DescriptorSetLayout getLayout() const { return *layout; }
+    vk::DescriptorSet getSet() const { return *set; }
+    uint32_t getCapacity(HeapArray array) const { return get(array).capacity; }
+    uint32_t getUsed(HeapArray array) const { return get(array).next - static_cast<uint32_t>(get(array).free_slots.size()); }
+
+    void destroy();
+
+private:
+    struct SlotArray{
+        uint32_t capacity = 0;
+        uint32_t next = 0; // Slots below next were handed out at least once
+        std::vector<uint32_t> free_slots; // Released and safe to write again
+        std::vector<std::pair<TimelinePoint, uint32_t>> retired_slots; // Released, still readable by the GPU
+    };
+
+    const vk::raii::Device * logical_device = nullptr;
+    Timeline * timeline = nullptr;
+
+    vk::raii::DescriptorSetLayout layout = nullptr;
+    vk::raii::DescriptorPool pool = nullptr;
+    vk::raii::DescriptorSet set = nullptr;
+    std::array<SlotArray, static_cast<size_t>(HeapArray::COUNT)> arrays;
+
+    SlotArray &get(HeapArray array) { return arrays[static_cast<size_t>(array)]; }
+    const SlotArray &get(HeapArray array) const { return arrays[static_cast<size_t>(array)]; }
+
+    uint32_t allocate(HeapArray array);
+    void write(HeapArray array, uint32_t slot, const vk::DescriptorBufferInfo *buffer_info, const vk::DescriptorImageInfo *image_info);
+};
@@ -1,4 +1,5 @@
 #include "device.hpp"
+#include "cpuprofiler.hpp"
 
 // Helper function for VmaResults
 const char* Device::VmaResultToString(VkResult r) {
@@ -75,7 +76,13 @@ vk::raii::Device Device::createLogicalDevice(const vk::raii::PhysicalDevice &phy
     vk::PhysicalDeviceVulkan12Features vulkan12features;
     vulkan12features.bufferDeviceAddress = true; // Memory can be referenced by a pointer rather than just a descriptor set
     vulkan12features.descriptorBindingPartiallyBound = true;
+    vulkan12features.runtimeDescriptorArray = true; // Descriptor heap arrays are indexed with slots from push constants
+    vulkan12features.descriptorBindingStorageBufferUpdateAfterBind = true; // Heap slots are written while the heap is bound
+    vulkan12features.descriptorBindingSampledImageUpdateAfterBind = true;
+    vulkan12features.descriptorBindingUpdateUnusedWhilePending = true;
     vulkan12features.scalarBlockLayout = true;
+    vulkan12features.timelineSemaphore = true; // Used by the upload queue
+    vulkan12features.drawIndirectCount = supportsDrawIndirectCount(physical_device); // Optional, GPU culling falls back to CPU without it
 
     vk::PhysicalDeviceVulkan13Features vulkan13features;
     vulkan13features.synchronization2 = true;
@@ -178,6 +185,10 @@ uint8_t Device::calculateScore(vk::raii::PhysicalDevice &device){
     bool supports_vulkan_12_properties =
         features.template get<vk::PhysicalDeviceVulkan12Features>().bufferDeviceAddress && // Allows for pointer to buffer, bypass the need to bind a buffer to a descriptor set
         features.template get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingPartiallyBound && // Allows for partially constructed descriptor sets
+        features.template get<vk::PhysicalDeviceVulkan12Features>().runtimeDescriptorArray && // Unsized descriptor arrays in shaders
+        features.template get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingStorageBufferUpdateAfterBind && // Descriptor heap slots change while bound
+        features.template get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingSampledImageUpdateAfterBind &&
+        features.template get<vk::PhysicalDeviceVulkan12Features>().descriptorBindingUpdateUnusedWhilePending &&
         features.template get<vk::PhysicalDeviceVulkan12Features>().scalarBlockLayout; // relaxes alignment rules
 
     bool supports_vulkan_13_properties = 
@@ -197,6 +208,12 @@ uint8_t Device::calculateScore(vk::raii::PhysicalDevice &device){
     return score;
 }
 
+bool Device::supportsDrawIndirectCount(const vk::raii::PhysicalDevice &physical_device)
+{
+    auto features = physical_device.template getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
+    return features.template get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+}
+
 void Device::findQueueFamilies(const vk::raii::PhysicalDevice &physical_device, const vk::raii::SurfaceKHR &surface, QueuePool &indices){
     std::vector<vk::QueueFamilyProperties> queue_family_properties = physical_device.getQueueFamilyProperties();
     uint32_t i = 0;
@@ -213,8 +230,13 @@ void Device::findQueueFamilies(const vk::raii::PhysicalDevice &physical_device,
             indices.transfer_family = i;
         }
 
-        // Find a presentation queue
-        if(physical_device.getSurfaceSupportKHR(i, *surface)){
+        // Find a presentation queue. Without a surface (headless) nothing is presented, the graphics queue stands in
+        if(!*surface){
+            if(queue_family.queueFlags & vk::QueueFlagBits::eGraphics){
+                indices.present_family = i;
+            }
+        }
+        else if(physical_device.getSurfaceSupportKHR(i, *surface)){
             indices.present_family = i;
         }
 
@@ -250,8 +272,26 @@ vk::raii::CommandBuffers Device::createCommandBuffer(vk::raii::CommandPool &comm
 
 }
 
+void Device::createSecondaryCommandBuffers(QueuePool &queue_pool, uint32_t thread_count, vk::raii::Device &logical_device)
+{
+    queue_pool.secondary_command_buffers.clear();
+    queue_pool.secondary_command_pools.clear();
+    queue_pool.secondary_command_pools.resize(queue_pool.max_frames_in_flight);
+    queue_pool.secondary_command_buffers.resize(queue_pool.max_frames_in_flight);
+
+    for(int frame = 0; frame < queue_pool.max_frames_in_flight; frame++){
+        for(uint32_t thread = 0; thread < thread_count; thread++){
+            // The pool is reset whole, so its buffers need no individual reset flag
+            queue_pool.secondary_command_pools[frame].push_back(createCommandPool(logical_device, vk::CommandPoolCreateFlagBits::eTransient, queue_pool.graphics_family.value()));
+            vk::raii::CommandBuffers buffers = createCommandBuffer(queue_pool.secondary_command_pools[frame].back(), vk::CommandBufferLevel::eSecondary, 1, logical_device);
+            queue_pool.secondary_command_buffers[frame].push_back(std::move(buffers[0]));
+        }
+    }
+}
+
 AllocatedBuffer Device::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, std::string name, VmaAllocator &vma_allocator)
 {
+    PROFILE_ZONE("create buffer");
     AllocatedBuffer buffer;
 
     // Prepare VMA alloc info
@@ -259,7 +299,11 @@ AllocatedBuffer Device::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags u
     alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
 
     // Decide flags by host-visible property
-    if ((properties & vk::MemoryPropertyFlagBits::eHostVisible) != vk::MemoryPropertyFlags{}) {
+    if ((properties & vk::MemoryPropertyFlagBits::eHostVisible) && (properties & vk::MemoryPropertyFlagBits::eHostCached)) {
+        // Readback buffer: read by the CPU, so random access on cached memory
+        alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+        alloc_info.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    } else if ((properties & vk::MemoryPropertyFlagBits::eHostVisible) != vk::MemoryPropertyFlags{}) {
         // Staging-like buffer: request mapped & sequential write host access
         alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
     } else {
@@ -292,14 +336,39 @@ AllocatedBuffer Device::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags u
     return buffer;
 }
 
+vk::DeviceAddress Device::getBufferAddress(const AllocatedBuffer &buffer, const vk::raii::Device &logical_device)
+{
+    if(!buffer.buffer){
+        throw std::runtime_error("Device address of a null buffer!");
+    }
+    return logical_device.getBufferAddress(vk::BufferDeviceAddressInfo(buffer.buffer));
+}
+
 void Device::copyBuffer(AllocatedBuffer &source_buffer, AllocatedBuffer &destination_buffer, 
     vk::DeviceSize size, vk::raii::Device &logical_device, QueuePool &queue_pool, vk::DeviceSize src_offset)
 {
+    PROFILE_ZONE("copy buffer");
     vk::raii::CommandBuffer command_buffer_copy = beginSingleTimeCommands(queue_pool.transfer_command_pool, logical_device);
     command_buffer_copy.copyBuffer(source_buffer.buffer, destination_buffer.buffer, vk::BufferCopy(src_offset, 0, size));
     endSingleTimeCommands(command_buffer_copy, queue_pool.transfer_queue);
 }
 
+void Device::memoryBarrier(vk::raii::CommandBuffer &command_buffer, vk::PipelineStageFlags2 src_stage_mask, vk::AccessFlags2 src_access_mask,
+                        vk::PipelineStageFlags2 dst_stage_mask, vk::AccessFlags2 dst_access_mask)
+{
+    vk::MemoryBarrier2 barrier{};
+    barrier.srcStageMask = src_stage_mask;
+    barrier.srcAccessMask = src_access_mask;
+    barrier.dstStageMask = dst_stage_mask;
+    barrier.dstAccessMask = dst_access_mask;
+
+    vk::DependencyInfo dependency_info{};
+    dependency_info.memoryBarrierCount = 1;
+    dependency_info.pMemoryBarriers = &barrier;
+
+    command_buffer.pipelineBarrier2(dependency_info);
+}
+
 vk::raii::CommandBuffer Device::beginSingleTimeCommands(vk::raii::CommandPool& command_pool, vk::raii::Device &logical_device){
     vk::CommandBufferAllocateInfo alloc_info;
     alloc_info.commandPool = command_pool;
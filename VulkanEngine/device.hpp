@@ -12,6 +12,9 @@ namespace Device{
     // Returns a score based on device capabilities. Return a score of 0 if device is not suitable for the application. Right now, score is 1 for all GPUs and 2 for discrete ones
     uint8_t calculateScore(vk::raii::PhysicalDevice &device);
 
+    // Returns whether the device can take the draw count of indirect draws from a buffer (needed by GPU culling)
+    bool supportsDrawIndirectCount(const vk::raii::PhysicalDevice &physical_device);
+
     // Find the queue family indices. Modifies the indices structure passed as parameter
     void findQueueFamilies(const vk::raii::PhysicalDevice &physical_device, const vk::raii::SurfaceKHR &surface, QueuePool &indices);
 
@@ -21,16 +24,26 @@ namespace Device{
     // Creates the necessary command buffers
     vk::raii::CommandBuffers createCommandBuffer(vk::raii::CommandPool &command_pool, vk::CommandBufferLevel level, int max_frames_in_flight, vk::raii::Device &logical_device);
 
+    // Creates thread_count graphics pools per frame in flight, each with one secondary command buffer
+    void createSecondaryCommandBuffers(QueuePool &queue_pool, uint32_t thread_count, vk::raii::Device &logical_device);
+
     // Helper function for printing vma operation results
     const char* VmaResultToString(VkResult r);
 
     // Creates a buffer
     AllocatedBuffer createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, std::string name, VmaAllocator &vma_allocator);
 
+    // GPU pointer to the start of a buffer created with vk::BufferUsageFlagBits::eShaderDeviceAddress
+    vk::DeviceAddress getBufferAddress(const AllocatedBuffer &buffer, const vk::raii::Device &logical_device);
+
     // Copies one buffer into another
     void copyBuffer(AllocatedBuffer &source_buffer, AllocatedBuffer &destination_buffer, vk::DeviceSize size, vk::raii::Device &logical_device, QueuePool &queue_pool,
                     vk::DeviceSize src_offset);
     
+    // Helper function to add a global memory barrier between two stage masks
+    void memoryBarrier(vk::raii::CommandBuffer &command_buffer, vk::PipelineStageFlags2 src_stage_mask, vk::AccessFlags2 src_access_mask,
+                    vk::PipelineStageFlags2 dst_stage_mask, vk::AccessFlags2 dst_access_mask);
+
     // Functions for single time commands
     vk::raii::CommandBuffer beginSingleTimeCommands(vk::raii::CommandPool &command_pool, vk::raii::Device &logical_device);
     void endSingleTimeCommands(vk::raii::CommandBuffer &command_buffer, vk::raii::Queue &queue);
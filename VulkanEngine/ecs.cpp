@@ -0,0 +1,184 @@
+#include "ecs.hpp"
+
+// --- COMPONENT REGISTRY ---
+
+namespace{
+    std::vector<ECS::ComponentInfo> &componentInfos(){
+        static std::vector<ECS::ComponentInfo> infos;
+        return infos;
+    }
+}
+
+uint32_t ECS::registerComponent(const ComponentInfo &info)
+{
+    std::vector<ComponentInfo> &infos = componentInfos();
+    if(infos.size() >= MAX_COMPONENTS){
+        throw std::runtime_error("Too many component types!");
+    }
+    if(info.alignment > COLUMN_ALIGNMENT){
+        throw std::runtime_error("Component alignment larger than the chunk columns!");
+    }
+
+    infos.push_back(info);
+    return static_cast<uint32_t>(infos.size() - 1);
+}
+
+const ECS::ComponentInfo &ECS::getComponentInfo(uint32_t id)
+{
+    return componentInfos()[id];
+}
+
+// --- ARCHETYPE ---
+
+ECS::Archetype::Archetype(ComponentMask mask) : mask(mask)
+{
+    size_t row_size = 0;
+    for(uint32_t id = 0; id < MAX_COMPONENTS; id++){
+        if(mask & (ComponentMask(1) << id)){
+            components.push_back(id);
+            row_size += getComponentInfo(id).size;
+        }
+    }
+
+    // Each array may lose up to COLUMN_ALIGNMENT bytes to padding
+    size_t usable = CHUNK_SIZE - COLUMN_ALIGNMENT * components.size();
+    capacity = row_size > 0 ? static_cast<uint32_t>(usable / row_size) : static_cast<uint32_t>(CHUNK_SIZE);
+    if(capacity == 0){
+        throw std::runtime_error("Archetype row does not fit in a chunk!");
+    }
+
+    size_t offset = 0;
+    for(uint32_t id : components){
+        offset = (offset + COLUMN_ALIGNMENT - 1) & ~(COLUMN_ALIGNMENT - 1);
+        offsets[id] = offset;
+        offset += getComponentInfo(id).size * capacity;
+    }
+}
+
+ECS::Archetype::~Archetype()
+{
+    clear();
+}
+
+void ECS::Archetype::allocateRow(Entity entity, uint32_t &chunk_index, uint32_t &row)
+{
+    if(chunks.empty() || chunks.back().count == capacity){
+        chunks.emplace_back();
+        chunks.back().entities.resize(capacity);
+    }
+
+    Chunk &chunk = chunks.back();
+    chunk_index = static_cast<uint32_t>(chunks.size() - 1);
+    row = chunk.count++;
+    chunk.entities[row] = entity;
+}
+
+std::optional<ECS::Entity> ECS::Archetype::removeRow(uint32_t chunk_index, uint32_t row)
+{
+    Chunk &chunk = chunks[chunk_index];
+    Chunk &last_chunk = chunks.back();
+    uint32_t last_row = last_chunk.count - 1;
+    bool is_last = &chunk == &last_chunk && row == last_row;
+
+    std::optional<Entity> moved;
+    for(uint32_t id : components){
+        const ComponentInfo &info = getComponentInfo(id);
+        void * target = static_cast<std::byte *>(column(chunk, id)) + info.size * row;
+        info.destroy(target);
+        if(!is_last){
+            void * source = static_cast<std::byte *>(column(last_chunk, id)) + info.size * last_row;
+            info.move_construct(target, source);
+            info.destroy(source);
+        }
+    }
+    if(!is_last){
+        moved = last_chunk.entities[last_row];
+        chunk.entities[row] = *moved;
+    }
+
+    last_chunk.count--;
+    if(last_chunk.count == 0){
+        chunks.pop_back();
+    }
+    return moved;
+}
+
+void ECS::Archetype::clear()
+{
+    for(Chunk &chunk : chunks){
+        for(uint32_t id : components){
+            const ComponentInfo &info = getComponentInfo(id);
+            std::byte * array = static_cast<std::byte *>(column(chunk, id));
+            for(uint32_t row = 0; row < chunk.count; row++){
+                info.destroy(array + info.size * row);
+            }
+        }
+    }
+    chunks.clear();
+}
+
+// --- WORLD ---
+
+void ECS::World::destroy(Entity entity)
+{
+    if(!isAlive(entity)){
+        return;
+    }
+
+    EntityRecord &record = records[entity.index];
+    std::optional<Entity> moved = record.archetype -> removeRow(record.chunk, record.row);
+    if(moved){
+        records[moved -> index].chunk = record.chunk;
+        records[moved -> index].row = record.row;
+    }
+
+    record.archetype = nullptr;
+    record.generation++;
+    free_indices.push_back(entity.index);
+    alive_count--;
+}
+
+void ECS::World::clear()
+{
+    for(std::unique_ptr<Archetype> &archetype : archetypes){
+        archetype -> clear();
+    }
+
+    free_indices.clear();
+    for(uint32_t i = 0; i < records.size(); i++){
+        if(records[i].archetype){
+            records[i].archetype = nullptr;
+            records[i].generation++;
+        }
+        free_indices.push_back(i);
+    }
+    alive_count = 0;
+}
+
+ECS::Archetype &ECS::World::getArchetype(ComponentMask mask)
+{
+    auto it = archetype_lookup.find(mask);
+    if(it != archetype_lookup.end()){
+        return *it -> second;
+    }
+
+    archetypes.push_back(std::make_unique<Archetype>(mask));
+    archetype_lookup[mask] = archetypes.back().get();
+    return *archetypes.back();
+}
+
+ECS::Entity ECS::World::allocateEntity()
+{
+    uint32_t index;
+    if(!free_indices.empty()){
+        index = free_indices.back();
+        free_indices.pop_back();
+    }
+    else{
+        index = static_cast<uint32_t>(records.size());
+        records.emplace_back();
+    }
+
+    alive_count++;
+    return Entity{index, records[index].generation};
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include <unordered_map>
+#include <memory>
+#include <bit>
+
+namespace ECS{
+    const uint32_t MAX_COMPONENTS = 64; // One bit each in a ComponentMask
+    const size_t CHUNK_SIZE = 16 * 1024; // Bytes of component data per chunk
+    const size_t COLUMN_ALIGNMENT = 64; // Every component array starts on its own cache line
+
+    using ComponentMask = uint64_t;
+
+    // Index in the World plus a generation, so handles to destroyed entities are detected
+    struct Entity{
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool operator==(const Entity &other) const = default;
+    };
+
+    // Type-erased operations of a component type, so archetypes can move rows around
+    struct ComponentInfo{
+        size_t size;
+        size_t alignment;
+        void (*move_construct)(void * dst, void * src);
+        void (*destroy)(void * ptr);
+    };
+
+    // Registers a component type and returns its id. Called once per type by componentId
+    uint32_t registerComponent(const ComponentInfo &info);
+    const ComponentInfo &getComponentInfo(uint32_t id);
+
+    template<typename T>
+    uint32_t componentId(){
+        static const uint32_t id = registerComponent(ComponentInfo{
+            sizeof(T),
+            alignof(T),
+            [](void * dst, void * src){ new (dst) T(std::move(*static_cast<T *>(src))); },
+            [](void * ptr){ static_cast<T *>(ptr) -> ~T(); }
+        });
+        return id;
+    }
+
+    template<typename... Components>
+    ComponentMask componentMask(){
+        return ((ComponentMask(1) << componentId<Components>()) | ... | ComponentMask(0));
+    }
+
+    // Fixed block of memory holding the components of up to Archetype::getCapacity() entities, one array per component
+    struct Chunk{
+        struct Storage{
+            alignas(COLUMN_ALIGNMENT) std::byte bytes[CHUNK_SIZE];
+        };
+
+        std::unique_ptr<Storage> data = std::make_unique<Storage>();
+        std::vector<Entity> entities; // Entity of each row
+        uint32_t count = 0;
+    };
+
+    /**
+     * Storage of every entity with the same set of components.
+     * Entities live in chunks, each chunk keeps one contiguous array per component, so a system touching two components
+     * walks two dense arrays and never loads the others. Every chunk is full except the last one: removing a row
+     * moves the last row of the archetype into the hole.
+     */
+    class Archetype{
+    public:
+        explicit Archetype(ComponentMask mask);
+        ~Archetype();
+
+        Archetype(const Archetype&) = delete;
+        Archetype& operator=(const Archetype&) = delete;
+
+        ComponentMask getMask() const { return mask; }
+        uint32_t getCapacity() const { return capacity; }
+        bool contains(ComponentMask components) const { return (mask & components) == components; }
+
+        std::vector<Chunk> &getChunks() { return chunks; }
+
+        // Start of the array of the given component inside chunk
+        void * column(Chunk &chunk, uint32_t component) const { return chunk.data -> bytes + offsets[component]; }
+
+        template<typename T>
+        T * column(Chunk &chunk) const { return reinterpret_cast<T *>(column(chunk, componentId<T>())); }
+
+        // Reserves a row for entity at the end of the archetype. Its components are left unconstructed
+        void allocateRow(Entity entity, uint32_t &chunk_index, uint32_t &row);
+
+        // Destroys the components of a row and fills it with the last row. Returns the entity that was moved, if any
+        std::optional<Entity> removeRow(uint32_t chunk_index, uint32_t row);
+
+        // Destroys every row
+        void clear();
+
+    private:
+        ComponentMask mask;
+        std::vector<uint32_t> components; // Ids of the components in mask
+        std::array<size_t, MAX_COMPONENTS> offsets{}; // Byte offset of each component array inside a chunk
+        uint32_t capacity = 0;
+        std::vector<Chunk> chunks;
+    };
+
+    // Chunk of an archetype, so chunk iteration can be split across threads
+    struct ChunkRef{
+        Archetype * archetype = nullptr;
+        Chunk * chunk = nullptr;
+
+        // Calls func(count, Components *...) on the chunk, which must hold all the components
+        template<typename... Components, typename Func>
+        void visit(Func &&func) const{
+            func(chunk -> count, archetype -> column<Components>(*chunk)...);
+        }
+    };
+
+    /**
+     * Owner of every entity and its components.
+     * An entity's set of components picks its Archetype when it is created. Systems go through eachChunk/each,
+     * which only visit the archetypes holding the requested components and only touch those arrays.
+     */
+    class World{
+    public:
+        World() = default;
+        ~World() { clear(); }
+
+        World(const World&) = delete;
+        World& operator=(const World&) = delete;
+
+        // Creates an entity owning the given components
+        template<typename... Components>
+        Entity create(Components... components){
+            ComponentMask mask = componentMask<Components...>();
+            if(std::popcount(mask) != sizeof...(Components)){
+                throw std::runtime_error("Entity created with the same component twice!");
+            }
+
+            Archetype &archetype = getArchetype(mask);
+            Entity entity = allocateEntity();
+            EntityRecord &record = records[entity.index];
+            record.archetype = &archetype;
+            archetype.allocateRow(entity, record.chunk, record.row);
+
+            Chunk &chunk = archetype.getChunks()[record.chunk];
+            (new (archetype.column<Components>(chunk) + record.row) Components(std::move(components)), ...);
+            return entity;
+        }
+
+        // Destroys the entity and its components. Handles to it stop being alive
+        void destroy(Entity entity);
+
+        bool isAlive(Entity entity) const{
+            return entity.index < records.size() && records[entity.index].archetype && records[entity.index].generation == entity.generation;
+        }
+
+        template<typename T>
+        bool has(Entity entity) const{
+            return isAlive(entity) && records[entity.index].archetype -> contains(componentMask<T>());
+        }
+
+        // Component of a living entity that owns it
+        template<typename T>
+        T &get(Entity entity){
+            if(!has<T>(entity)){
+                throw std::runtime_error("Entity has no such component!");
+            }
+            const EntityRecord &record = records[entity.index];
+            return record.archetype -> column<T>(record.archetype -> getChunks()[record.chunk])[record.row];
+        }
+
+        // Calls func(count, Components *...) once per chunk holding all the components, with one array per component
+        template<typename... Components, typename Func>
+        void eachChunk(Func &&func){
+            ComponentMask mask = componentMask<Components...>();
+            for(std::unique_ptr<Archetype> &archetype : archetypes){
+                if(!archetype -> contains(mask)){
+                    continue;
+                }
+                for(Chunk &chunk : archetype -> getChunks()){
+                    if(chunk.count > 0){
+                        func(chunk.count, archetype -> column<Components>(chunk)...);
+                    }
+                }
+            }
+        }
+
+        // Fills out with the non-empty chunks holding all the components. Valid until entities are created or destroyed
+        template<typename... Components>
+        void collectChunks(std::vector<ChunkRef> &out){
+            out.clear();
+            ComponentMask mask = componentMask<Components...>();
+            for(std::unique_ptr<Archetype> &archetype : archetypes){
+                if(!archetype -> contains(mask)){
+                    continue;
+                }
+                for(Chunk &chunk : archetype -> getChunks()){
+                    if(chunk.count > 0){
+                        out.push_back(ChunkRef{archetype.get(), &chunk});
+                    }
+                }
+            }
+        }
+
+        // Calls func(Components &...) for every entity holding all the components
+        template<typename... Components, typename Func>
+        void each(Func &&func){
+            eachChunk<Components...>([&func](uint32_t count, Components *... columns){
+                for(uint32_t i = 0; i < count; i++){
+                    func(columns[i]...);
+                }
+            });
+        }
+
+        // Number of entities holding all the components
+        template<typename... Components>
+        uint32_t count(){
+            uint32_t total = 0;
+            eachChunk<Components...>([&total](uint32_t count, Components *...){ total += count; });
+            return total;
+        }
+
+        // Number of living entities
+        uint32_t size() const { return alive_count; }
+
+        // Destroys every entity
+        void clear();
+
+    private:
+        struct EntityRecord{
+            Archetype * archetype = nullptr; // nullptr when the index is free
+            uint32_t chunk = 0;
+            uint32_t row = 0;
+            uint32_t generation = 0;
+        };
+
+        std::vector<EntityRecord> records; // Indexed by Entity::index
+        std::vector<uint32_t> free_indices;
+        std::vector<std::unique_ptr<Archetype>> archetypes;
+        std::unordered_map<ComponentMask, Archetype *> archetype_lookup;
+        uint32_t alive_count = 0;
+
+        Archetype &getArchetype(ComponentMask mask);
+        Entity allocateEntity();
+    };
+}
@@ -9,10 +9,13 @@
 
 // Gets GLFW extensions for Vulkan and necessary extensions for debugging
 std::vector<const char *> Engine::getRequiredExtensions(){
-    uint32_t glfw_extension_count = 0;
-    auto glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+    std::vector<const char *> extensions;
+    if(!headless){ // No window means no surface extensions
+        uint32_t glfw_extension_count = 0;
+        auto glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
 
-    std::vector extensions(glfw_extensions, glfw_extensions + glfw_extension_count);
+        extensions.assign(glfw_extensions, glfw_extensions + glfw_extension_count);
+    }
     if(enable_val_layers){
         extensions.push_back(vk::EXTDebugUtilsExtensionName); // debug messanger extension
     }
@@ -45,13 +48,43 @@ void Engine::init(const std::string title, uint32_t &w, uint32_t &h)
     this -> win_width = w;
     this -> win_height = h;
 
-    initWindow();
+    if(headless){
+        // There is no monitor to fill, fall back to a fixed resolution
+        if(!win_width || !win_height){
+            win_width = 1280;
+            win_height = 720;
+        }
+    }
+    else{
+        initWindow();
+    }
 
+    jobs.create();
     initVulkan();
 
     std::cout << "\nCOMPLETED INITIALIZATION" << std::endl;
 }
 
+void Engine::setHeadless(uint32_t frame_count, std::string readback_path)
+{
+    headless = true;
+    headless_frames = frame_count;
+    this -> readback_path = std::move(readback_path);
+}
+
+void Engine::setProfiling(std::string trace_path)
+{
+    this -> trace_path = std::move(trace_path);
+    Profiler::setEnabled(true);
+    Profiler::setThreadName("main");
+}
+
+void Engine::setFrameRate(uint32_t fps, bool align_present)
+{
+    frame_pacer.setTargetFPS(fps);
+    frame_pacer.setPresentAlignment(align_present);
+}
+
 // Initializes the window system using GLTF
 void Engine::initWindow()
 {
@@ -61,7 +94,7 @@ void Engine::initWindow()
     }
     window = GLFWHelper::initWindowGLFW(title.c_str(), win_width, win_height);
 
-    glfwSetWindowUserPointer(window, &inputs);
+    glfwSetWindowUserPointer(window, this);
 
     std::cout << "width: " << win_width << " height: " << win_height << std::endl;
 
@@ -70,13 +103,22 @@ void Engine::initWindow()
     }
 
     glfwSetKeyCallback(window, recordInput);
+    glfwSetFramebufferSizeCallback(window, recordResize);
+
+    // Refresh rate of the monitor, for the pacer to align with
+    const GLFWvidmode * mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if(mode){
+        frame_pacer.setDisplayRefresh(static_cast<float>(mode -> refreshRate));
+    }
 }
 
 // Initialize all Vulkan Components
 void Engine::initVulkan(){
     createInstance();
     setupDebugMessanger();
-    createSurface();
+    if(!headless){
+        createSurface();
+    }
 
     // Device setup
     std::cout << "\nDEVICE SETUP..." << std::endl;
@@ -89,6 +131,7 @@ void Engine::initVulkan(){
     if(!queue_pool.isQueueComplete()){
         throw std::runtime_error("Error during creation of queues!");
     }
+    timeline.create(logical_device);
 
     /**
      * eResetCommandBuffer -> allows to reset individual command buffers allocated from this pool without having to reset the entire pool at once
@@ -101,32 +144,49 @@ void Engine::initVulkan(){
     }
 
     queue_pool.graphics_command_buffers = Device::createCommandBuffer(queue_pool.graphics_command_pool, vk::CommandBufferLevel::ePrimary, queue_pool.max_frames_in_flight, logical_device);
+    Device::createSecondaryCommandBuffers(queue_pool, jobs.getThreadCount(), logical_device);
+    gpu_profiler.create(physical_device, logical_device, queue_pool.graphics_family.value(), queue_pool.max_frames_in_flight);
     
     // Swapchain setup
     std::cout << "\nSWAPCHAIN SETUP..." << std::endl;
-    swapchain = Swapchain::createSwapchain(physical_device, logical_device, surface, window, queue_pool);
+    if(headless){
+        // No presentation engine: frames are rendered straight into color_image
+        swapchain.format = vk::Format::eB8G8R8A8Srgb;
+        swapchain.extent = vk::Extent2D(win_width, win_height);
+        std::cout << "Headless mode, skipping swapchain. Extent: " << win_width << ", " << win_height << std::endl;
+    }
+    else{
+        swapchain = Swapchain::createSwapchain(physical_device, logical_device, surface, window, queue_pool);
+    }
 
     // Memory Allocator setup
     std::cout << "\nMEMORY ALLOCATOR SETUP..." << std::endl;
     vma_allocator = MemoryAllocator::createMemoryAllocator(physical_device, logical_device, instance);
-
-    // Color Image setup
-    std::cout << "\nCOLOR IMAGE SETUP..." << std::endl;
-    color_image = Image::createImage(swapchain.extent.width, swapchain.extent.height, vk::ImageType::e2D,
-                                    1, msaa_samples, swapchain.format, 1, vk::ImageTiling::eOptimal,
-                                vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eColorAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, 
-                                "color image", {}, vma_allocator);
-    color_image.image_view = Image::createImageView(color_image, logical_device);
-
-    depth_image = Image::createImage(swapchain.extent.width, swapchain.extent.height, vk::ImageType::e2D,
-                                    1, msaa_samples, Image::findDepthFormat(physical_device), 1,
-                                    vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment,
-                                    vk::MemoryPropertyFlagBits::eDeviceLocal, "depth image", {}, vma_allocator);
-    depth_image.image_view = Image::createImageView(depth_image, logical_device);
+    upload_queue.create(logical_device, queue_pool, timeline, vma_allocator);
+    geometry.create(MAX_GEOMETRY_VERTICES, MAX_GEOMETRY_INDICES, vma_allocator);
+    mesh_registry.create(geometry, upload_queue, queue_pool.max_frames_in_flight);
+
+    // Attachments setup
+    std::cout << "\nATTACHMENTS SETUP..." << std::endl;
+    depth_format = Image::findDepthFormat(physical_device);
+    transient_allocator.create(physical_device, logical_device, vma_allocator, queue_pool.max_frames_in_flight);
+    render_graph.setTransientAllocator(&transient_allocator);
+
+    if(headless){
+        createHeadlessTarget();
+    }
 
     // Pipeline Setup
     std::cout << "\nGENERAL SCENE RESOURCES SETUP..." << std::endl;
+    pipeline_cache.create(PIPELINE_CACHE_PATH, physical_device, logical_device);
+    pipeline_builder.set_pipeline_cache(&pipeline_cache.getCache());
+    shader_library.create(logical_device, SHADER_CACHE_DIRECTORY);
+    pipeline_builder.set_shader_library(&shader_library);
+    descriptor_heap.create(physical_device, logical_device, timeline);
+    pipeline_builder.set_descriptor_heap(&descriptor_heap);
+    pipeline_compiler.create(logical_device, &pipeline_cache.getCache());
     createInitResources();
+    reportPipelineCreation();
 
     // Synchronization objects Setup
     std::cout << "\nSYNCHRONIZATION OBJECTS SETUP..." << std::endl;
@@ -201,44 +261,21 @@ void Engine::createSurface(){
 
 void Engine::createInitResources(){
 
-    int total_obj = 10;
-    objects.reserve(total_obj);
-    for(int i = 0; i < total_obj; i++){
-        objects.push_back(Gameobject(glm::vec3(-(total_obj/2) + i, 0, -5), glm::vec3(1), glm::vec3(-45.f, 45.f, 0.f), glm::vec3(0, 0, 0), glm::vec3(.1f, .1f, 0)));
-    }
-    objects[0].start(vma_allocator, logical_device, queue_pool);
-
-    ubo_objects_mapped.clear();
-    ubo_objects_mapped.resize(total_obj);
-    vk::DeviceSize gameobject_buffer_size = sizeof(UniformBufferGameObjects);
-    for(size_t i = 0; i < total_obj; i++){
-        ubo_objects_mapped[i].resize(queue_pool.max_frames_in_flight);
-        for(size_t j = 0; j < queue_pool.max_frames_in_flight; j++){
-            ubo_objects_mapped[i][j].buffer = Device::createBuffer(
-                gameobject_buffer_size,
-                vk::BufferUsageFlagBits::eUniformBuffer,
-                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-                "Gameobject Buffer",
-                vma_allocator
-            );
-            vmaMapMemory(vma_allocator, ubo_objects_mapped[i][j].buffer.allocation, &ubo_objects_mapped[i][j].data);
-        }
-    }
+    // PER-FRAME DATA SETUP: camera and model matrices of all the instances. Objects can be spawned up to 1024 without new allocations
+    createFrameAllocator(1024);
 
-    // CAMERA RESOURCES SETUP
-    ubo_camera_mapped.clear();
-    ubo_camera_mapped.resize(queue_pool.max_frames_in_flight);
-    vk::DeviceSize camera_buffer_size = sizeof(UniformBufferCamera);
+    // Every object shares the same cube, uploaded once and drawn by the first pipeline
+    draw_meshes.push_back(mesh_registry.load(Meshes::cube()));
+    upload_queue.flush();
 
-    for(size_t i = 0; i < queue_pool.max_frames_in_flight; i++){
-        ubo_camera_mapped[i].buffer = Device::createBuffer(
-            camera_buffer_size,
-            vk::BufferUsageFlagBits::eUniformBuffer,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-            "Camera Buffer",
-            vma_allocator
-        );
-        vmaMapMemory(vma_allocator, ubo_camera_mapped[i].buffer.allocation, &ubo_camera_mapped[i].data);
+    int total_obj = 10;
+    for(int i = 0; i < total_obj; i++){
+        Transform transform;
+        transform.position = glm::vec3(-(total_obj/2) + i, 0, -5);
+        transform.rotation = glm::vec3(-45.f, 45.f, 0.f);
+        Velocity velocity;
+        velocity.angular = glm::vec3(.1f, .1f, 0);
+        spawnObject(transform, velocity, 0);
     }
 
     camera = Camera(glm::vec3(0, 0, 2));
@@ -248,30 +285,27 @@ void Engine::createInitResources(){
     const std::string vertex_shader_path = "Shaders/Samples/vertex.vert.spv";
     const std::string fragment_shader_path = "Shaders/Samples/fragment.frag.spv";
 
-    std::vector<vk::DescriptorSetLayoutBinding> bindings = {
-        // Binding 0: Camera Uniform Object
-        vk::DescriptorSetLayoutBinding(
-            0, // binding location
-            vk::DescriptorType::eUniformBuffer, // Type of binding
-            1, // binding count
-            vk::ShaderStageFlagBits::eVertex,
-            nullptr
-        ),
-
-        // Binding 1: GameObject Uniform Buffer
-        vk::DescriptorSetLayoutBinding(
-            1,
-            vk::DescriptorType::eUniformBuffer,
-            total_obj,
-            vk::ShaderStageFlagBits::eVertex,
-            nullptr
-        )
-    };
-    std::string name = "dumb pipeline";
+    // Camera and model matrices are read through device addresses, the pipeline has no set of its own.
+    // Built right away: it is the fallback of the pipelines compiled in the background
+    configureRasterPipeline("dumb pipeline", vertex_shader_path, fragment_shader_path);
+    raster_pipelines.push_back(pipeline_builder.build(nullptr, logical_device));
+    pipeline_tickets.emplace_back();
 
+    // With GPU culling the vertex shader reads the compacted matrices written by the culling pass
+    createCullingResources();
+}
+
+void Engine::configureRasterPipeline(const std::string &name, const std::string &vertex_shader_path, const std::string &fragment_shader_path,
+                                     const std::vector<std::string> &fragment_defines)
+{
     pipeline_builder.set_name(name);
-    pipeline_builder.add_shader(vertex_shader_path, vk::ShaderStageFlagBits::eVertex, logical_device);
-    pipeline_builder.add_shader(fragment_shader_path, vk::ShaderStageFlagBits::eFragment, logical_device);
+    pipeline_builder.add_shader(vertex_shader_path, vk::ShaderStageFlagBits::eVertex);
+    if(fragment_defines.empty()){
+        pipeline_builder.add_shader(fragment_shader_path, vk::ShaderStageFlagBits::eFragment);
+    }
+    else{
+        pipeline_builder.add_shader_variant(fragment_shader_path, vk::ShaderStageFlagBits::eFragment, fragment_defines);
+    }
     pipeline_builder.set_topology(vk::PrimitiveTopology::eTriangleList);
     pipeline_builder.set_rasterizer(vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise, vk::PolygonMode::eFill);
     pipeline_builder.set_multisampling_none();
@@ -279,51 +313,191 @@ void Engine::createInitResources(){
                                                     vk::ColorComponentFlagBits::eG | 
                                                     vk::ColorComponentFlagBits::eB | 
                                                     vk::ColorComponentFlagBits::eA);
-    pipeline_builder.set_color_and_depth_format({swapchain.format}, Image::findDepthFormat(physical_device));
+    pipeline_builder.set_color_and_depth_format({swapchain.format}, depth_format);
     pipeline_builder.set_depth_stencil(true, true, vk::CompareOp::eLess);
+    pipeline_builder.set_push_constant(vk::ShaderStageFlagBits::eVertex, 0, sizeof(DrawPushConstants));
+}
 
-    raster_pipelines.push_back(pipeline_builder.build(&bindings, logical_device));
-    
-    raster_pipelines[0].descriptor_pool = PipelineBuilder::createDescriptorPool(bindings, logical_device, queue_pool.max_frames_in_flight);
-    raster_pipelines[0].descriptor_sets = PipelineBuilder::createDescriptorSets(raster_pipelines[0].descriptor_set_layout,
-                                                                        raster_pipelines[0].descriptor_pool,
+ECS::Entity Engine::spawnObject(const Transform &transform, const Velocity &velocity, uint32_t draw)
+{
+    if(world.count<RenderInfo>() >= max_objects){
+        throw std::runtime_error("Too many objects for the per-frame storage!");
+    }
+
+    Bounds bounds;
+    bounds.local_sphere = draw_meshes[draw].getLocalSphere();
+    bounds.local_min = draw_meshes[draw].getLocalMin();
+    bounds.local_max = draw_meshes[draw].getLocalMax();
+    return world.create(transform, velocity, ModelMatrix(), bounds, MeshComponent{draw_meshes[draw]}, RenderInfo{draw, RENDER_VISIBLE});
+}
+
+void Engine::createFrameAllocator(uint32_t max_objects)
+{
+    this -> max_objects = max_objects;
+
+    // Allocations are also read through device addresses, which shaders declare 16 byte aligned (buffer_reference_align)
+    vk::DeviceSize alignment = std::max<vk::DeviceSize>(FrameAllocator::getRequiredAlignment(physical_device), sizeof(glm::vec4));
+    vk::DeviceSize camera_size = sizeof(UniformBufferCamera);
+    vk::DeviceSize objects_size = sizeof(glm::mat4) * max_objects;
+    vk::DeviceSize draw_ids_size = sizeof(uint32_t) * max_objects;
+    vk::DeviceSize indirect_size = 16 + sizeof(CullDraw) * MAX_CULL_DRAWS; // draw count (padded to 16 bytes) + draws
+    vk::DeviceSize frame_size = FrameAllocator::alignUp(camera_size, alignment) + FrameAllocator::alignUp(objects_size, alignment) +
+                                FrameAllocator::alignUp(draw_ids_size, alignment) + FrameAllocator::alignUp(indirect_size, alignment);
+
+    frame_allocator.create(frame_size, queue_pool.max_frames_in_flight,
+        vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferSrc |
+        vk::BufferUsageFlagBits::eShaderDeviceAddress, alignment, vma_allocator);
+
+    camera_buffer_info = frame_allocator.getDescriptorInfo(camera_size);
+    objects_buffer_info = frame_allocator.getDescriptorInfo(objects_size);
+    draw_ids_buffer_info = frame_allocator.getDescriptorInfo(draw_ids_size);
+    frame_buffer_address = Device::getBufferAddress(frame_allocator.getBuffer(), logical_device);
+}
+
+void Engine::createCullingResources()
+{
+    gpu_culling = Device::supportsDrawIndirectCount(physical_device);
+    if(!gpu_culling){
+        std::cout << "drawIndirectCount not supported, GPU culling disabled" << std::endl;
+        return;
+    }
+    if(raster_pipelines.size() > MAX_CULL_DRAWS){
+        throw std::runtime_error("Too many raster pipelines for GPU culling!");
+    }
+
+    // One draw per pipeline. Its instances are laid out contiguously in visible_buffer, first_instance is set every frame
+    cull_draws.clear();
+    for(size_t i = 0; i < raster_pipelines.size(); i++){
+        CullDraw draw;
+        const MeshRange &mesh = draw_meshes[i].getRange();
+        draw.command = vk::DrawIndexedIndirectCommand(mesh.index_count, 0, mesh.first_index, mesh.vertex_offset, 0);
+        draw.local_sphere = draw_meshes[i].getLocalSphere();
+        cull_draws.push_back(draw);
+    }
+
+    vk::DeviceSize alignment = frame_allocator.getAlignment();
+    vk::DeviceSize indirect_size = 16 + sizeof(CullDraw) * cull_draws.size();
+    indirect_frame_size = FrameAllocator::alignUp(indirect_size, alignment);
+    visible_frame_size = FrameAllocator::alignUp(objects_buffer_info.range, alignment);
+
+    indirect_buffer = Device::createBuffer(indirect_frame_size * queue_pool.max_frames_in_flight,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, "Indirect Buffer", vma_allocator);
+    visible_buffer = Device::createBuffer(visible_frame_size * queue_pool.max_frames_in_flight,
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eShaderDeviceAddress, vk::MemoryPropertyFlagBits::eDeviceLocal,
+        "Visible Objects Buffer", vma_allocator);
+
+    indirect_buffer_info = vk::DescriptorBufferInfo{indirect_buffer.buffer, 0, indirect_size};
+    visible_buffer_info = vk::DescriptorBufferInfo{visible_buffer.buffer, 0, objects_buffer_info.range};
+    visible_buffer_address = Device::getBufferAddress(visible_buffer, logical_device);
+
+    // Every binding is dynamic: the frame slice is chosen at bind time
+    std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+        // Binding 0: model matrices of all the instances
+        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute, nullptr),
+        // Binding 1: draw of each instance
+        vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute, nullptr),
+        // Binding 2: draw count and indirect draws
+        vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute, nullptr),
+        // Binding 3: compacted model matrices of the visible instances
+        vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eStorageBufferDynamic, 1, vk::ShaderStageFlagBits::eCompute, nullptr)
+    };
+
+    pipeline_builder.set_name("frustum culling");
+    pipeline_builder.set_push_constant(vk::ShaderStageFlagBits::eCompute, 0, sizeof(CullPushConstants));
+    cull_pipeline = pipeline_builder.build_compute("Shaders/Samples/cull.comp.spv", &bindings, logical_device,
+                                                   ShaderSpecialization().set(0, CULL_WORKGROUP_SIZE));
+
+    cull_pipeline.descriptor_pool = PipelineBuilder::createDescriptorPool(bindings, logical_device, queue_pool.max_frames_in_flight);
+    cull_pipeline.descriptor_sets = PipelineBuilder::createDescriptorSets(cull_pipeline.descriptor_set_layout,
+                                                                        cull_pipeline.descriptor_pool,
                                                                         logical_device,
                                                                         queue_pool.max_frames_in_flight);
     std::vector<void *> resources{
-        &ubo_camera_mapped,
-        &ubo_objects_mapped
+        &objects_buffer_info,
+        &draw_ids_buffer_info,
+        &indirect_buffer_info,
+        &visible_buffer_info
     };
-    PipelineBuilder::writeDescriptorSets(raster_pipelines[0].descriptor_sets, bindings, resources, logical_device, queue_pool.max_frames_in_flight);
-
-    
-    pip_to_obj[&raster_pipelines[0]] = std::vector<Gameobject*>();
-    pip_to_obj[&raster_pipelines[0]].reserve(objects.size());
-    for(size_t i = 0; i < objects.size(); i++){
-        pip_to_obj[&raster_pipelines[0]].push_back(&objects[i]);
-    }
+    PipelineBuilder::writeDescriptorSets(cull_pipeline.descriptor_sets, bindings, resources, logical_device, queue_pool.max_frames_in_flight);
 }
 
 void Engine::createSyncObjects()
 {
     present_complete_semaphores.clear();
+    frame_done.assign(queue_pool.max_frames_in_flight, TimelinePoint{}); // Value 0, reached from the start
+
+    // The acquire semaphore of a frame is free again once the frame's previous submission is done
+    for(size_t i = 0; i < queue_pool.max_frames_in_flight; i++){
+        present_complete_semaphores.emplace_back(vk::raii::Semaphore(logical_device, vk::SemaphoreCreateInfo()));
+    }
+
+    createSwapchainSemaphores();
+}
+
+void Engine::createSwapchainSemaphores()
+{
     render_finished_semaphores.clear();
-    in_flight_fences.clear();
 
     for(size_t i = 0; i < swapchain.images.size(); i++){
-        present_complete_semaphores.emplace_back(vk::raii::Semaphore(logical_device, vk::SemaphoreCreateInfo()));
         render_finished_semaphores.emplace_back(vk::raii::Semaphore(logical_device, vk::SemaphoreCreateInfo()));
     }
+}
 
-    for(size_t i = 0; i < queue_pool.max_frames_in_flight; i++){
-        in_flight_fences.emplace_back(vk::raii::Fence(logical_device, {vk::FenceCreateFlagBits::eSignaled}));
+
+void Engine::reportPipelineCreation()
+{
+    float creation_ms = pipeline_builder.get_creation_time();
+    if(pipeline_cache.isWarm()){
+        std::cout << "Pipeline creation: " << creation_ms << " ms (warm cache)";
+        if(pipeline_cache.getColdCreationTime() > 0.f){
+            std::cout << ", cold: " << pipeline_cache.getColdCreationTime() << " ms";
+        }
+        std::cout << std::endl;
     }
+    else{
+        std::cout << "Pipeline creation: " << creation_ms << " ms (cold cache)" << std::endl;
+    }
+    std::cout << "Shader modules: " << shader_library.getModuleCount() << std::endl;
+}
+
+void Engine::createHeadlessTarget()
+{
+    // Outlives the frames since it is copied back after the run, so it does not come from the transient allocator
+    color_image = Image::createImage(swapchain.extent.width, swapchain.extent.height, vk::ImageType::e2D,
+                                    1, msaa_samples, swapchain.format, 1, vk::ImageTiling::eOptimal,
+                                vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eColorAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, 
+                                "color image", {}, vma_allocator);
+    color_image.image_view = Image::createImageView(color_image, logical_device);
+
+    swapchain.images.clear();
+    swapchain.image_views.clear();
+
+    swapchain.images.push_back(color_image.image);
+    swapchain.image_views.push_back(Image::createImageView(color_image, logical_device));
+
+    // Leave the image ready to be copied back instead of presented, with the color writes visible to the copy
+    target_final_state = ImageState{vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead};
 }
 
 
 // --- RUN FUNCTIONS ---
 
 void Engine::run(){
+    if(headless){
+        runHeadless();
+        return;
+    }
+
     while(!glfwWindowShouldClose(window)){
+        // Nothing can be drawn while minimized, sleep until an event brings the window back
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        if(width == 0 || height == 0){
+            glfwWaitEvents();
+            continue;
+        }
         glfwPollEvents();
         drawFrame();
     }
@@ -333,86 +507,382 @@ void Engine::run(){
 
 void Engine::drawFrame()
 {
-    if (target_fps > 0) {
-        float target_ms = 1000.0f / target_fps;
-        auto current_time = std::chrono::high_resolution_clock::now();
-        
-        // Calculate how much time has passed since the last frame
-        float elapsed = std::chrono::duration<float, std::milli>(current_time - prev_time).count();
-        
-        // If we are rendering faster than our target, put the thread to sleep
-        if (elapsed < target_ms) {
-            std::this_thread::sleep_for(std::chrono::duration<float, std::milli>(target_ms - elapsed));
-        }
+    PROFILE_ZONE("frame");
+    {
+        PROFILE_ZONE("pace frame");
+        frame_pacer.wait();
     }
     
     // CPU block
-    while(vk::Result::eTimeout == logical_device.waitForFences(*in_flight_fences[current_frame], vk::True, UINT64_MAX));
+    {
+        PROFILE_ZONE("wait frame");
+        timeline.wait(frame_done[current_frame]);
+    }
+    auto cpu_start = std::chrono::high_resolution_clock::now();
 
-    // GPU block
-    auto [result, image_index] = swapchain.swapchain.acquireNextImage(UINT64_MAX, *present_complete_semaphores[present_semaphore_index], nullptr);
+    // GPU block. Headless frames have a single target and nothing to acquire
+    uint32_t image_index = 0;
+    if(!headless){
+        if(swapchain_dirty && !recreateSwapchain()){
+            return; // Minimized, nothing to draw into
+        }
+
+        PROFILE_ZONE("acquire image");
+        vk::Result result = vk::Result::eSuccess;
+        try{
+            std::tie(result, image_index) = swapchain.swapchain.acquireNextImage(UINT64_MAX, *present_complete_semaphores[current_frame], nullptr);
+        }
+        catch(const vk::OutOfDateKHRError &){
+            // Nothing was acquired and the semaphore is still unsignaled, the frame is simply tried again
+            swapchain_dirty = true;
+            return;
+        }
 
-    if(result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR){
-        throw std::runtime_error("failed to acquire swap chain image!");
+        if(result == vk::Result::eSuboptimalKHR){
+            swapchain_dirty = true; // Still presentable, replaced next frame
+        }
+        else if(result != vk::Result::eSuccess){
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
     }
+    releaseRetiredResources();
 
-    // Resetting the synchronization components
-    logical_device.resetFences(*in_flight_fences[current_frame]);
     queue_pool.graphics_command_buffers[current_frame].reset();
 
     std::chrono::_V2::system_clock::time_point current_time = std::chrono::high_resolution_clock::now();
     time = std::chrono::duration<float, std::chrono::milliseconds::period>(current_time - prev_time).count();
     prev_time = current_time;
 
-    processInput();
-    updateUniformBuffers(time, current_frame);
-    recordCommandBuffer(image_index);
-
-    vk::PipelineStageFlags wait_destination_stage_mask(vk::PipelineStageFlagBits::eColorAttachmentOutput);
-    vk::SubmitInfo submit_info;
-    submit_info.waitSemaphoreCount = 1;
-    submit_info.pWaitSemaphores = &*present_complete_semaphores[present_semaphore_index];
-    submit_info.pWaitDstStageMask = &wait_destination_stage_mask;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &*queue_pool.graphics_command_buffers[current_frame];
-    submit_info.signalSemaphoreCount = 1;
-    submit_info.pSignalSemaphores = &*render_finished_semaphores[image_index];
-
-    queue_pool.graphics_queue.submit(submit_info, *in_flight_fences[current_frame]);
-
-    vk::PresentInfoKHR present_info_KHR;
-    present_info_KHR.waitSemaphoreCount = 1;
-    present_info_KHR.pWaitSemaphores = &*render_finished_semaphores[image_index];
-    present_info_KHR.swapchainCount = 1;
-    present_info_KHR.pSwapchains = &*swapchain.swapchain;
-    present_info_KHR.pImageIndices = &image_index;
-
-    result = queue_pool.present_queue.presentKHR(present_info_KHR);
-    switch(result){
-        case vk::Result::eSuccess: break;
-        case vk::Result::eSuboptimalKHR:
-            std::cout << "vk::Queue::presentKHR returned vk::Result::eSuboptimalKHR !\n";
-            break;
-        default: break; // an unexpected result is returned
+    {
+        PROFILE_ZONE("process input");
+        processInput();
+        processProfilerInput();
+        processWindowInput();
     }
+    {
+        PROFILE_ZONE("update pipelines");
+        updatePipelines();
+    }
+    {
+        PROFILE_ZONE("update uniform buffers");
+        updateUniformBuffers(time, current_frame);
+    }
+    {
+        PROFILE_ZONE("record command buffer");
+        recordCommandBuffer(image_index);
+    }
+    updateWindowTitle();
+
+    // Binary semaphores for the swapchain, the graphics timeline for everything waiting on the frame
+    frame_done[current_frame] = timeline.next(QueueType::GRAPHICS);
+    std::vector<vk::SemaphoreSubmitInfo> wait_infos;
+    std::vector<vk::SemaphoreSubmitInfo> signal_infos = {timeline.signalInfo(frame_done[current_frame], vk::PipelineStageFlagBits2::eAllCommands)};
+    if(!headless){
+        wait_infos.push_back(vk::SemaphoreSubmitInfo(*present_complete_semaphores[current_frame], 0, vk::PipelineStageFlagBits2::eColorAttachmentOutput));
+        signal_infos.push_back(vk::SemaphoreSubmitInfo(*render_finished_semaphores[image_index], 0, vk::PipelineStageFlagBits2::eAllCommands));
+    }
+    vk::CommandBufferSubmitInfo command_buffer_info(*queue_pool.graphics_command_buffers[current_frame]);
+    vk::SubmitInfo2 submit_info({}, wait_infos, command_buffer_info, signal_infos);
 
+    {
+        PROFILE_ZONE("submit");
+        queue_pool.graphics_queue.submit2(submit_info, nullptr);
+    }
+    cpu_time = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - cpu_start).count();
+
+    if(!headless){
+        PROFILE_ZONE("present");
+        vk::PresentInfoKHR present_info_KHR;
+        present_info_KHR.waitSemaphoreCount = 1;
+        present_info_KHR.pWaitSemaphores = &*render_finished_semaphores[image_index];
+        present_info_KHR.swapchainCount = 1;
+        present_info_KHR.pSwapchains = &*swapchain.swapchain;
+        present_info_KHR.pImageIndices = &image_index;
+
+        vk::Result result = vk::Result::eSuccess;
+        try{
+            result = queue_pool.present_queue.presentKHR(present_info_KHR);
+        }
+        catch(const vk::OutOfDateKHRError &){
+            result = vk::Result::eErrorOutOfDateKHR;
+        }
+        frame_pacer.markPresent();
+        if(result != vk::Result::eSuccess){
+            swapchain_dirty = true; // Suboptimal or out of date
+        }
+    }
+
+    mesh_registry.endFrame();
     current_frame = (current_frame + 1) % queue_pool.max_frames_in_flight;
-    present_semaphore_index = (present_semaphore_index + 1) % present_complete_semaphores.size();
+}
+
+bool Engine::recreateSwapchain()
+{
+    int width = 0;
+    int height = 0;
+    glfwGetFramebufferSize(window, &width, &height);
+    if(width == 0 || height == 0){
+        return false;
+    }
+
+    PROFILE_ZONE("recreate swapchain");
+    // The frames in flight keep presenting from the old swapchain, it goes once the last of them is done
+    RetiredSwapchain retired{timeline.last(QueueType::GRAPHICS), std::move(swapchain), {}};
+    swapchain = Swapchain::createSwapchain(physical_device, logical_device, surface, window, queue_pool, *retired.swapchain.swapchain);
+
+    for(vk::raii::Semaphore &semaphore : render_finished_semaphores){
+        retired.semaphores.push_back(std::move(semaphore));
+    }
+    createSwapchainSemaphores();
+    retired_swapchains.push_back(std::move(retired));
+
+    swapchain_dirty = false;
+    return true;
+}
+
+void Engine::releaseRetiredResources()
+{
+    descriptor_heap.update();
+
+    for(size_t i = 0; i < retired_swapchains.size();){
+        if(timeline.isComplete(retired_swapchains[i].last_use)){
+            retired_swapchains[i] = std::move(retired_swapchains.back());
+            retired_swapchains.pop_back();
+        }
+        else{
+            i++;
+        }
+    }
+}
+
+void Engine::processWindowInput()
+{
+    if(!window || !inputs.count(GLFW_KEY_F11) || inputs[GLFW_KEY_F11] != InputState::PRESSED){
+        return;
+    }
+    inputs[GLFW_KEY_F11] = InputState::RELEASED;
+
+    // The framebuffer callback follows, the swapchain is replaced on the next frame
+    if(!fullscreen){
+        GLFWmonitor * monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode * mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+        if(!mode){
+            std::cerr << "No monitor to go fullscreen on" << std::endl;
+            return;
+        }
+        glfwGetWindowPos(window, &windowed_rect[0], &windowed_rect[1]);
+        glfwGetWindowSize(window, &windowed_rect[2], &windowed_rect[3]);
+        glfwSetWindowMonitor(window, monitor, 0, 0, mode -> width, mode -> height, mode -> refreshRate);
+    }
+    else{
+        glfwSetWindowMonitor(window, nullptr, windowed_rect[0], windowed_rect[1], windowed_rect[2], windowed_rect[3], 0);
+    }
+    fullscreen = !fullscreen;
+    swapchain_dirty = true;
+}
+
+void Engine::processProfilerInput()
+{
+    if(!trace_path.empty() && inputs.count(GLFW_KEY_P) && inputs[GLFW_KEY_P] == InputState::PRESSED){
+        Profiler::writeChromeTrace(trace_path);
+        inputs[GLFW_KEY_P] = InputState::RELEASED;
+    }
+}
+
+void Engine::updateWindowTitle()
+{
+    title_timer += time;
+    if(!window || title_timer < TITLE_INTERVAL){
+        return;
+    }
+    title_timer = 0.f;
+
+    std::string title = std::to_string(1000.0/time);
+    if(gpu_profiler.isEnabled()){
+        title += " | GPU: " + std::to_string(gpu_profiler.getLast("frame")) + " ms";
+    }
+    if(!gpu_culling && world.size() > 0){
+        title += " | visible: " + std::to_string(culling_stats.visible) + " culled: " + std::to_string(culling_stats.culled);
+    }
+    glfwSetWindowTitle(window, title.c_str());
+}
+
+void Engine::runHeadless()
+{
+    std::cout << "\nRUNNING " << headless_frames << " HEADLESS FRAMES..." << std::endl;
+
+    double total_cpu_time = 0.0;
+    uint64_t total_visible = 0;
+    uint64_t total_culled = 0;
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for(uint32_t i = 0; i < headless_frames; i++){
+        drawFrame();
+        total_cpu_time += cpu_time;
+        total_visible += culling_stats.visible;
+        total_culled += culling_stats.culled;
+    }
+    logical_device.waitIdle();
+    double total_time = std::chrono::duration<double, std::chrono::milliseconds::period>(std::chrono::high_resolution_clock::now() - start_time).count();
+
+    if(headless_frames > 0){
+        std::cout << "Frames: " << headless_frames
+                  << "\nTotal time: " << total_time << " ms"
+                  << "\nAvg frame time: " << total_time / headless_frames << " ms (" << 1000.0 * headless_frames / total_time << " FPS)"
+                  << "\nAvg CPU time per frame (no frame wait): " << total_cpu_time / headless_frames << " ms" << std::endl;
+        if(!gpu_culling){
+            std::cout << "Avg CPU culling: " << total_visible / headless_frames << " visible, " << total_culled / headless_frames << " culled" << std::endl;
+        }
+
+        if(!readback_path.empty()){
+            readbackColorImage(readback_path);
+        }
+    }
+}
+
+void Engine::readbackColorImage(const std::string &path)
+{
+    const uint32_t width = swapchain.extent.width;
+    const uint32_t height = swapchain.extent.height;
+    vk::DeviceSize size = (vk::DeviceSize)width * height * 4;
+
+    // Read by the CPU, so cached memory rather than write-combined
+    AllocatedBuffer readback_buffer = Device::createBuffer(size, vk::BufferUsageFlagBits::eTransferDst,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached, "readback buffer", vma_allocator);
+
+    vk::BufferImageCopy region;
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0; // tightly packed
+    region.bufferImageHeight = 0;
+    region.imageSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1);
+    region.imageOffset = vk::Offset3D(0, 0, 0);
+    region.imageExtent = vk::Extent3D(width, height, 1);
+
+    vk::raii::CommandBuffer command_buffer = Device::beginSingleTimeCommands(queue_pool.graphics_command_pool, logical_device);
+    command_buffer.copyImageToBuffer(color_image.image, vk::ImageLayout::eTransferSrcOptimal, readback_buffer.buffer, region);
+    Device::endSingleTimeCommands(command_buffer, queue_pool.graphics_queue);
+
+    std::ofstream file(path, std::ios::binary);
+    if(!file.is_open()){
+        throw std::runtime_error("failed to open file: " + path);
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+
+    void * data;
+    vmaMapMemory(vma_allocator, readback_buffer.allocation, &data);
+    vmaInvalidateAllocation(vma_allocator, readback_buffer.allocation, 0, VK_WHOLE_SIZE);
+
+    // color_image is BGRA, PPM wants RGB
+    const uint8_t * pixels = static_cast<const uint8_t *>(data);
+    std::vector<char> row(width * 3);
+    for(uint32_t y = 0; y < height; y++){
+        for(uint32_t x = 0; x < width; x++){
+            const uint8_t * pixel = pixels + ((size_t)y * width + x) * 4;
+            row[x * 3 + 0] = pixel[2];
+            row[x * 3 + 1] = pixel[1];
+            row[x * 3 + 2] = pixel[0];
+        }
+        file.write(row.data(), row.size());
+    }
+    vmaUnmapMemory(vma_allocator, readback_buffer.allocation);
+
+    std::cout << "Written last frame to: " << path << std::endl;
 }
 
 void Engine::recordInput(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
-    std::map<int, InputState> &inputs = *reinterpret_cast<std::map<int, InputState> *>(glfwGetWindowUserPointer(window));
+    std::map<int, InputState> &inputs = reinterpret_cast<Engine *>(glfwGetWindowUserPointer(window)) -> inputs;
 
     inputs[key] = action == GLFW_PRESS ? InputState::PRESSED : (action == GLFW_REPEAT ? InputState::HOLD : InputState::RELEASED);
 }
 
+void Engine::recordResize(GLFWwindow *window, int width, int height)
+{
+    reinterpret_cast<Engine *>(glfwGetWindowUserPointer(window)) -> swapchain_dirty = true;
+}
+
 void Engine::processInput()
 {
     if(inputs.count(GLFW_KEY_SPACE) && inputs[GLFW_KEY_SPACE] == InputState::PRESSED){
         std::cout << "You would have jumped, if there were a jumping feature!" << std::endl;
         inputs[GLFW_KEY_SPACE] = InputState::RELEASED; // to indicate input ahs been consumed
     }
+    // Recompiles the raster pipeline in the background, frames keep going meanwhile
+    if(inputs.count(GLFW_KEY_R) && inputs[GLFW_KEY_R] == InputState::PRESSED){
+        setRasterShaders(0, "Shaders/Samples/vertex.vert.spv", "Shaders/Samples/fragment.frag.spv");
+        inputs[GLFW_KEY_R] = InputState::RELEASED;
+    }
+    // Swaps in the depth view variant, compiled by glslc on first use and cached on disk
+    if(inputs.count(GLFW_KEY_V) && inputs[GLFW_KEY_V] == InputState::PRESSED){
+        inputs[GLFW_KEY_V] = InputState::RELEASED;
+        try{
+            if(show_depth){
+                setRasterShaders(0, "Shaders/Samples/vertex.vert.spv", "Shaders/Samples/fragment.frag.spv");
+            }
+            else{
+                setRasterShaders(0, "Shaders/Samples/vertex.vert.spv", "Shaders/Samples/fragment.frag", {"SHOW_DEPTH"});
+            }
+            show_depth = !show_depth;
+        }
+        catch(const std::runtime_error &error){
+            std::cerr << error.what() << std::endl;
+            pipeline_builder.pipeline_bundle = RasterPipelineBundle(); // Drop the half configured state
+        }
+    }
+}
+
+void Engine::setRasterShaders(uint32_t draw, const std::string &vertex_shader_path, const std::string &fragment_shader_path,
+                              const std::vector<std::string> &fragment_defines)
+{
+    // A compilation still running for draw is dropped, its pipeline is destroyed with the ticket
+    configureRasterPipeline(raster_pipelines[draw].name, vertex_shader_path, fragment_shader_path, fragment_defines);
+    pipeline_tickets[draw] = pipeline_builder.rebuild_async(raster_pipelines[draw].layout, pipeline_compiler);
+}
+
+void Engine::updatePipelines()
+{
+    // A replaced pipeline goes once the last submission that could bind it is done
+    for(size_t i = 0; i < retired_pipelines.size();){
+        if(timeline.isComplete(retired_pipelines[i].first)){
+            retired_pipelines[i] = std::move(retired_pipelines.back());
+            retired_pipelines.pop_back();
+        }
+        else{
+            i++;
+        }
+    }
+
+    for(size_t i = 0; i < pipeline_tickets.size(); i++){
+        PipelineTicket &ticket = pipeline_tickets[i];
+        if(!ticket.isReady()){
+            continue;
+        }
+        if(ticket.hasFailed()){
+            // The draw keeps its current pipeline (or the fallback), a fixed shader can simply be submitted again
+            std::cerr << "Failed to compile pipeline " << ticket.getName() << ": " << ticket.getError() << std::endl;
+            ticket = PipelineTicket();
+            continue;
+        }
+
+        std::cout << "Pipeline " << ticket.getName() << " ready after " << ticket.getLatency() << " ms (creation "
+                  << ticket.getCreationTime() << " ms)" << std::endl;
+        if(*raster_pipelines[i].pipeline){
+            retired_pipelines.emplace_back(timeline.last(QueueType::GRAPHICS), std::move(raster_pipelines[i].pipeline));
+        }
+        raster_pipelines[i].pipeline = ticket.take();
+        ticket = PipelineTicket();
+    }
+}
+
+const vk::raii::Pipeline *Engine::getDrawPipeline(uint32_t draw) const
+{
+    if(*raster_pipelines[draw].pipeline){
+        return &raster_pipelines[draw].pipeline;
+    }
+    // The fallback is only valid with a layout compatible with the draw's one (same bindings and push constants)
+    if(fallback_pipeline >= 0 && *raster_pipelines[fallback_pipeline].pipeline){
+        return &raster_pipelines[fallback_pipeline].pipeline;
+    }
+    return nullptr;
 }
 
 void Engine::updateUniformBuffers(float dtime, int current_frame)
@@ -422,86 +892,364 @@ void Engine::updateUniformBuffers(float dtime, int current_frame)
     ubo_camera.view = camera.getViewMatrix();
     ubo_camera.proj = camera.getProjectionMatrix(swapchain.extent.width * 1.f / swapchain.extent.height);
 
-    memcpy(ubo_camera_mapped[current_frame].data, &ubo_camera, sizeof(UniformBufferCamera));
+    frame_allocator.beginFrame(current_frame);
 
-    UniformBufferGameObjects ubo_obj;
-    for(size_t i = 0; i < objects.size(); i++){
-        objects[i].update(dtime);
-        ubo_obj.model = objects[i].getModelMat();
+    FrameAllocation camera_allocation = frame_allocator.allocate(sizeof(UniformBufferCamera));
+    memcpy(camera_allocation.data, &ubo_camera, sizeof(UniformBufferCamera));
 
-        memcpy(ubo_objects_mapped[i][current_frame].data, &ubo_obj, sizeof(UniformBufferGameObjects));
+    // The descriptor range is fixed, so the whole object range is reserved even if fewer objects are alive
+    FrameAllocation objects_allocation = frame_allocator.allocate(objects_buffer_info.range);
+    glm::mat4 * models = static_cast<glm::mat4 *>(objects_allocation.data);
+
+    Systems::integrateVelocities(world, dtime, jobs);
+    Systems::updateTransforms(world, jobs);
+
+    if(!gpu_culling){
+        cullObjects(models);
+    }
+
+    draw_constants = {frame_buffer_address + camera_allocation.offset, frame_buffer_address + objects_allocation.offset};
+
+    if(gpu_culling){
+        // The culling pass reads every visible matrix and the draw it belongs to
+        FrameAllocation draw_ids_allocation = frame_allocator.allocate(draw_ids_buffer_info.range);
+        uint32_t * draw_ids = static_cast<uint32_t *>(draw_ids_allocation.data);
+        std::vector<std::atomic<uint32_t>> draw_counts(cull_draws.size());
+        world.collectChunks<ModelMatrix, RenderInfo>(upload_chunks);
+        upload_offsets.assign(upload_chunks.size() + 1, 0);
+
+        // First pass counts the visible instances of every chunk, so each chunk gets its own slice of the buffers
+        jobs.parallel_for(static_cast<uint32_t>(upload_chunks.size()), Systems::CHUNKS_PER_TASK, [&](uint32_t begin, uint32_t end){
+            std::vector<uint32_t> local_counts(draw_counts.size(), 0);
+            for(uint32_t c = begin; c < end; c++){
+                upload_chunks[c].visit<RenderInfo>([&](uint32_t count, RenderInfo * render){
+                    for(uint32_t i = 0; i < count; i++){
+                        if(render[i].flags & RENDER_VISIBLE){
+                            local_counts[render[i].draw]++;
+                            upload_offsets[c + 1]++;
+                        }
+                    }
+                });
+            }
+            for(size_t d = 0; d < local_counts.size(); d++){
+                if(local_counts[d] > 0){
+                    draw_counts[d] += local_counts[d];
+                }
+            }
+        });
+        for(size_t c = 1; c < upload_offsets.size(); c++){
+            upload_offsets[c] += upload_offsets[c - 1];
+        }
+        cull_object_count = upload_offsets.back();
+
+        // Second pass writes the slices straight into the mapped frame memory
+        jobs.parallel_for(static_cast<uint32_t>(upload_chunks.size()), Systems::CHUNKS_PER_TASK, [&](uint32_t begin, uint32_t end){
+            for(uint32_t c = begin; c < end; c++){
+                uint32_t instance = upload_offsets[c];
+                upload_chunks[c].visit<ModelMatrix, RenderInfo>([&](uint32_t count, ModelMatrix * matrices, RenderInfo * render){
+                    for(uint32_t i = 0; i < count; i++){
+                        if(render[i].flags & RENDER_VISIBLE){
+                            models[instance] = matrices[i].model;
+                            draw_ids[instance] = render[i].draw;
+                            instance++;
+                        }
+                    }
+                });
+            }
+        });
+
+        // Each draw gets a range of visible_buffer as big as its instance count
+        uint32_t first_instance = 0;
+        for(size_t i = 0; i < cull_draws.size(); i++){
+            cull_draws[i].command.firstInstance = first_instance;
+            first_instance += draw_counts[i];
+        }
+
+        // Templates are copied over the indirect buffer at the start of the frame: zero draw count and instance counts
+        FrameAllocation templates_allocation = frame_allocator.allocate(indirect_buffer_info.range);
+        memset(templates_allocation.data, 0, 16);
+        memcpy(static_cast<char *>(templates_allocation.data) + 16, cull_draws.data(), sizeof(CullDraw) * cull_draws.size());
+        cull_template_offset = templates_allocation.offset;
+
+        uint32_t indirect_offset = static_cast<uint32_t>(current_frame * indirect_frame_size);
+        uint32_t visible_offset = static_cast<uint32_t>(current_frame * visible_frame_size);
+        cull_dynamic_offsets = {objects_allocation.offset, draw_ids_allocation.offset, indirect_offset, visible_offset};
+        draw_constants.objects = visible_buffer_address + visible_offset;
     }
 }
 
+void Engine::cullObjects(glm::mat4 * models)
+{
+    PROFILE_ZONE("cull objects");
+    std::array<glm::vec4, 6> planes = camera.getFrustumPlanes(swapchain.extent.width * 1.f / swapchain.extent.height);
+
+    // Every drawn entity is tested in one batch. Chunks are counted first, so each one fills its own slice in parallel
+    world.collectChunks<ModelMatrix, Bounds, RenderInfo>(upload_chunks);
+    upload_offsets.assign(upload_chunks.size() + 1, 0);
+    jobs.parallel_for(static_cast<uint32_t>(upload_chunks.size()), Systems::CHUNKS_PER_TASK, [&](uint32_t begin, uint32_t end){
+        for(uint32_t c = begin; c < end; c++){
+            upload_chunks[c].visit<RenderInfo>([&](uint32_t count, RenderInfo * render){
+                for(uint32_t i = 0; i < count; i++){
+                    if(render[i].flags & RENDER_VISIBLE){
+                        upload_offsets[c + 1]++;
+                    }
+                }
+            });
+        }
+    });
+    for(size_t c = 1; c < upload_offsets.size(); c++){
+        upload_offsets[c] += upload_offsets[c - 1];
+    }
+
+    cull_spheres.resize(upload_offsets.back());
+    cull_models.resize(upload_offsets.back());
+    cull_draw_ids.resize(upload_offsets.back());
+    jobs.parallel_for(static_cast<uint32_t>(upload_chunks.size()), Systems::CHUNKS_PER_TASK, [&](uint32_t begin, uint32_t end){
+        for(uint32_t c = begin; c < end; c++){
+            uint32_t instance = upload_offsets[c];
+            upload_chunks[c].visit<ModelMatrix, Bounds, RenderInfo>([&](uint32_t count, ModelMatrix * matrices, Bounds * bounds, RenderInfo * render){
+                for(uint32_t i = 0; i < count; i++){
+                    if(render[i].flags & RENDER_VISIBLE){
+                        cull_spheres.set(instance, bounds[i].world_sphere);
+                        cull_models[instance] = &matrices[i].model;
+                        cull_draw_ids[instance] = render[i].draw;
+                        instance++;
+                    }
+                }
+            });
+        }
+    });
+    Culling::cullSpheres(cull_spheres, planes, cull_visible);
+
+    // Visible matrices are packed per pipeline, so every draw covers a contiguous instance range. Blocks of cull_visible
+    // count their instances per draw, then write them in parallel at their place in the draw's range, in the serial order
+    const uint32_t draw_count = static_cast<uint32_t>(raster_pipelines.size());
+    const uint32_t block_count = (static_cast<uint32_t>(cull_visible.size()) + PACK_BLOCK_SIZE - 1) / PACK_BLOCK_SIZE;
+    pack_offsets.assign(static_cast<size_t>(block_count) * draw_count, 0);
+    jobs.parallel_for(block_count, 1, [&](uint32_t begin, uint32_t end){
+        for(uint32_t block = begin; block < end; block++){
+            uint32_t last = std::min(static_cast<uint32_t>(cull_visible.size()), (block + 1) * PACK_BLOCK_SIZE);
+            for(uint32_t v = block * PACK_BLOCK_SIZE; v < last; v++){
+                pack_offsets[block * draw_count + cull_draw_ids[cull_visible[v]]]++;
+            }
+        }
+    });
+
+    draw_first_instance.assign(draw_count, 0);
+    draw_instance_count.assign(draw_count, 0);
+    uint32_t first_instance = 0;
+    for(uint32_t draw = 0; draw < draw_count; draw++){
+        draw_first_instance[draw] = first_instance;
+        for(uint32_t block = 0; block < block_count; block++){
+            uint32_t block_instances = pack_offsets[block * draw_count + draw];
+            pack_offsets[block * draw_count + draw] = first_instance;
+            first_instance += block_instances;
+        }
+        draw_instance_count[draw] = first_instance - draw_first_instance[draw];
+    }
+
+    jobs.parallel_for(block_count, 1, [&](uint32_t begin, uint32_t end){
+        for(uint32_t block = begin; block < end; block++){
+            uint32_t * cursors = &pack_offsets[block * draw_count];
+            uint32_t last = std::min(static_cast<uint32_t>(cull_visible.size()), (block + 1) * PACK_BLOCK_SIZE);
+            for(uint32_t v = block * PACK_BLOCK_SIZE; v < last; v++){
+                uint32_t index = cull_visible[v];
+                models[cursors[cull_draw_ids[index]]++] = *cull_models[index];
+            }
+        }
+    });
+
+    culling_stats.visible = static_cast<uint32_t>(cull_visible.size());
+    culling_stats.culled = cull_spheres.size() - culling_stats.visible;
+}
+
+void Engine::addCullingPasses(ResourceHandle frame_data, ResourceHandle indirect, ResourceHandle visible)
+{
+    // Reset this frame's draws from the templates
+    render_graph.addPass("reset draws")
+        .read(frame_data, ResourceUsage::TRANSFER_READ)
+        .write(indirect, ResourceUsage::TRANSFER_WRITE)
+        .setExecute([this](vk::raii::CommandBuffer &command_buffer){
+            vk::DeviceSize indirect_offset = current_frame * indirect_frame_size;
+            command_buffer.copyBuffer(frame_allocator.getBuffer().buffer, indirect_buffer.buffer,
+                vk::BufferCopy(cull_template_offset, indirect_offset, indirect_buffer_info.range));
+        });
+
+    // Fills the draw counts and compacts the visible matrices
+    render_graph.addPass("culling")
+        .read(frame_data, ResourceUsage::COMPUTE_READ)
+        .write(indirect, ResourceUsage::COMPUTE_WRITE)
+        .write(visible, ResourceUsage::COMPUTE_WRITE)
+        .setExecute([this](vk::raii::CommandBuffer &command_buffer){
+            CullPushConstants push_constants;
+            std::array<glm::vec4, 6> planes = camera.getFrustumPlanes(swapchain.extent.width * 1.f / swapchain.extent.height);
+            std::copy(planes.begin(), planes.end(), push_constants.planes);
+            push_constants.object_count = cull_object_count;
+
+            command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, *cull_pipeline.pipeline);
+            command_buffer.bindDescriptorSets(
+                vk::PipelineBindPoint::eCompute,
+                cull_pipeline.layout,
+                0,
+                *cull_pipeline.descriptor_sets[current_frame],
+                cull_dynamic_offsets
+            );
+            command_buffer.pushConstants<CullPushConstants>(cull_pipeline.layout, vk::ShaderStageFlagBits::eCompute, 0, push_constants);
+            command_buffer.dispatch((push_constants.object_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+        });
+}
+
+void Engine::recordSecondaryDraws(vk::raii::CommandBuffer &primary, uint32_t draw_count,
+                                  const std::function<void(vk::raii::CommandBuffer &, uint32_t, uint32_t)> &record)
+{
+    std::vector<vk::raii::CommandPool> &pools = queue_pool.secondary_command_pools[current_frame];
+    std::vector<vk::raii::CommandBuffer> &buffers = queue_pool.secondary_command_buffers[current_frame];
+    if(draw_count == 0 || buffers.empty()){
+        return;
+    }
+
+    // Contiguous ranges, one per secondary buffer, so executing them in order keeps the draw order
+    uint32_t slot_count = std::min(draw_count, static_cast<uint32_t>(buffers.size()));
+    uint32_t draws_per_slot = (draw_count + slot_count - 1) / slot_count;
+    slot_count = (draw_count + draws_per_slot - 1) / draws_per_slot;
+
+    // Secondaries continue the rendering block of the primary, they must know its attachments
+    vk::CommandBufferInheritanceRenderingInfo rendering_inheritance;
+    rendering_inheritance.colorAttachmentCount = 1;
+    rendering_inheritance.pColorAttachmentFormats = &swapchain.format;
+    rendering_inheritance.depthAttachmentFormat = depth_format;
+    rendering_inheritance.rasterizationSamples = msaa_samples;
+
+    vk::CommandBufferInheritanceInfo inheritance;
+    inheritance.pNext = &rendering_inheritance;
+
+    vk::CommandBufferBeginInfo begin_info;
+    begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit | vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+    begin_info.pInheritanceInfo = &inheritance;
+
+    // Each slot has its own pool, so slots can record at the same time
+    jobs.parallel_for(slot_count, 1, [&](uint32_t begin, uint32_t end){
+        PROFILE_ZONE("record draws");
+        for(uint32_t slot = begin; slot < end; slot++){
+            pools[slot].reset();
+            vk::raii::CommandBuffer &command_buffer = buffers[slot];
+            command_buffer.begin(begin_info);
+            // Dynamic state is not inherited from the primary
+            command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(swapchain.extent.width), static_cast<float>(swapchain.extent.height), 0.0f, 1.0f));
+            command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapchain.extent));
+            record(command_buffer, slot * draws_per_slot, std::min(draw_count, (slot + 1) * draws_per_slot));
+            command_buffer.end();
+        }
+    });
+
+    secondary_handles.clear();
+    for(uint32_t slot = 0; slot < slot_count; slot++){
+        secondary_handles.push_back(*buffers[slot]);
+    }
+    primary.executeCommands(secondary_handles);
+}
+
 void Engine::recordCommandBuffer(uint32_t image_index)
 {
     vk::raii::CommandBuffer &command_buffer = queue_pool.graphics_command_buffers[current_frame];
     command_buffer.begin({});
+    gpu_profiler.beginFrame(command_buffer, current_frame);
+    uint32_t frame_zone = gpu_profiler.beginZone(command_buffer, "frame");
+
+    // The target starts undefined after the acquire, whose semaphore is waited at color output, and is left for the
+    // presentation engine (copied back when headless)
+    render_graph.reset();
+    ResourceHandle target = render_graph.importImage("render target", swapchain.images[image_index], vk::ImageAspectFlagBits::eColor, 1, 1,
+        ImageState{vk::ImageLayout::eUndefined, vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eNone},
+        target_final_state);
+    ResourceHandle frame_data = render_graph.importBuffer("frame data", frame_allocator.getBuffer().buffer);
+    // Only lives inside the rendering pass, its memory is aliased or lazily allocated by the transient allocator
+    transient_allocator.beginFrame(current_frame);
+    ResourceHandle depth = render_graph.createImage("depth", depth_format, swapchain.extent, msaa_samples);
 
-    Image::transitionImageLayout(swapchain.images[image_index], 
-            vk::ImageLayout::eUndefined,
-		    vk::ImageLayout::eColorAttachmentOptimal,
-		    {},                                                        // srcAccessMask (no need to wait for previous operations)
-		    vk::AccessFlagBits2::eColorAttachmentWrite,                // dstAccessMask
-		    vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // srcStage
-		    vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // dstStage
-            vk::ImageAspectFlagBits::eColor,
-            command_buffer
-    );
-    vk::ClearValue  clear_color = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
-
-    vk::RenderingAttachmentInfo attachment_info{};
-    attachment_info.imageView = swapchain.image_views[image_index];
-    attachment_info.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
-    attachment_info.loadOp = vk::AttachmentLoadOp::eClear;
-    attachment_info.storeOp = vk::AttachmentStoreOp::eStore;
-    attachment_info.clearValue = clear_color;
-
-    vk::RenderingInfo rendering_info{};
-    rendering_info.renderArea.offset = vk::Offset2D{0, 0};
-    rendering_info.renderArea.extent = swapchain.extent;
-    rendering_info.layerCount = 1;
-    rendering_info.colorAttachmentCount = 1;
-    rendering_info.pColorAttachments = &attachment_info;
-
-    command_buffer.beginRendering(rendering_info);
     if(raster_pipelines.size() <= 0){
         throw std::runtime_error("There are no raster pipelines that can be used!");
     }
-    command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(swapchain.extent.width), static_cast<float>(swapchain.extent.height), 0.0f, 1.0f)); // What portion of the window to use
-    command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapchain.extent)); // What portion of the image to use
-    for(size_t i = 0; i < raster_pipelines.size(); i++){
-        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *(raster_pipelines[i].pipeline));
-        command_buffer.setCullMode(raster_pipelines[i].rasterizer.cullMode);
-        command_buffer.bindDescriptorSets(
-            vk::PipelineBindPoint::eGraphics,
-            raster_pipelines[i].layout,
-            0,
-            *raster_pipelines[i].descriptor_sets[current_frame],
-            {}
-        );
-        UniformBufferGameObjects ubo_obj;
-        command_buffer.bindVertexBuffers(0, pip_to_obj[&raster_pipelines[i]][0] -> getVertexBuffer(), {0});
-        command_buffer.bindIndexBuffer(pip_to_obj[&raster_pipelines[i]][0] -> getIndexBuffer(), 0, vk::IndexType::eUint32);
-        command_buffer.drawIndexed(pip_to_obj[&raster_pipelines[i]][0] -> getIndexSize(), objects.size(), 0, 0, 0);
-    }
-    command_buffer.endRendering();
-
-    // After rendering, transition the swapchain image to PRESENT_SRC
-    Image::transitionImageLayout(
-        swapchain.images[image_index],
-        vk::ImageLayout::eColorAttachmentOptimal,
-        vk::ImageLayout::ePresentSrcKHR,
-        vk::AccessFlagBits2::eColorAttachmentWrite,                // srcAccessMask
-        {},                                                        // dstAccessMask
-        vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // srcStage
-        vk::PipelineStageFlagBits2::eBottomOfPipe,                 // dstStage
-        vk::ImageAspectFlagBits::eColor,
-        command_buffer
-    );
-    command_buffer.end();
+    ResourceHandle indirect = 0;
+    ResourceHandle visible = 0;
+    if(gpu_culling){
+        indirect = render_graph.importBuffer("indirect draws", indirect_buffer.buffer);
+        visible = render_graph.importBuffer("visible objects", visible_buffer.buffer);
+        addCullingPasses(frame_data, indirect, visible);
+    }
 
-    glfwSetWindowTitle(window, std::to_string(1000.0/time).c_str());
+    RenderGraph::Pass &rendering = render_graph.addPass("rendering")
+        .read(frame_data, ResourceUsage::VERTEX_READ)
+        .write(target, ResourceUsage::COLOR_ATTACHMENT)
+        .write(depth, ResourceUsage::DEPTH_ATTACHMENT);
+    if(gpu_culling){
+        rendering.read(indirect, ResourceUsage::INDIRECT_READ).read(visible, ResourceUsage::VERTEX_READ);
+    }
+    rendering.setExecute([this, image_index, depth](vk::raii::CommandBuffer &command_buffer){
+        vk::ClearValue  clear_color = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
+
+        vk::RenderingAttachmentInfo attachment_info{};
+        attachment_info.imageView = swapchain.image_views[image_index];
+        attachment_info.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        attachment_info.loadOp = vk::AttachmentLoadOp::eClear;
+        attachment_info.storeOp = vk::AttachmentStoreOp::eStore;
+        attachment_info.clearValue = clear_color;
+
+        // Never stored, so tilers keep it on chip
+        vk::RenderingAttachmentInfo depth_info{};
+        depth_info.imageView = render_graph.getImageView(depth);
+        depth_info.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+        depth_info.loadOp = vk::AttachmentLoadOp::eClear;
+        depth_info.storeOp = vk::AttachmentStoreOp::eDontCare;
+        depth_info.clearValue = vk::ClearDepthStencilValue(1.0f, 0);
+
+        vk::RenderingInfo rendering_info{};
+        rendering_info.renderArea.offset = vk::Offset2D{0, 0};
+        rendering_info.renderArea.extent = swapchain.extent;
+        rendering_info.layerCount = 1;
+        rendering_info.colorAttachmentCount = 1;
+        rendering_info.pColorAttachments = &attachment_info;
+        rendering_info.pDepthAttachment = &depth_info;
+        rendering_info.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers; // Draws are recorded by the workers
+
+        command_buffer.beginRendering(rendering_info);
+        recordSecondaryDraws(command_buffer, static_cast<uint32_t>(raster_pipelines.size()), [this](vk::raii::CommandBuffer &draw_buffer, uint32_t begin, uint32_t end){
+            geometry.bind(draw_buffer); // Every mesh lives in the same buffers
+
+            // Every raster pipeline starts its layout with the heap and the same push constants, so both stay valid across pipeline binds.
+            // The draws only differ by pipeline and mesh, their data is behind the pushed addresses
+            draw_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, raster_pipelines[begin].layout, 0, descriptor_heap.getSet(), nullptr);
+            draw_buffer.pushConstants<DrawPushConstants>(raster_pipelines[begin].layout, vk::ShaderStageFlagBits::eVertex, 0, draw_constants);
+            for(uint32_t i = begin; i < end; i++){
+                const vk::raii::Pipeline *pipeline = getDrawPipeline(i);
+                if(!pipeline){
+                    continue; // Still compiling and no fallback
+                }
+                draw_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, **pipeline);
+                draw_buffer.setCullMode(raster_pipelines[i].rasterizer.cullMode);
+                if(gpu_culling){
+                    // Instance count and draw count come from the culling pass
+                    vk::DeviceSize indirect_offset = current_frame * indirect_frame_size;
+                    draw_buffer.drawIndexedIndirectCount(indirect_buffer.buffer, indirect_offset + 16 + i * sizeof(CullDraw),
+                                                         indirect_buffer.buffer, indirect_offset, 1, sizeof(CullDraw));
+                }
+                else{
+                    // Only the instances that survived CPU culling
+                    if(draw_instance_count[i] > 0){
+                        const MeshRange &mesh = draw_meshes[i].getRange();
+                        draw_buffer.drawIndexed(mesh.index_count, draw_instance_count[i], mesh.first_index, mesh.vertex_offset, draw_first_instance[i]);
+                    }
+                }
+            }
+        });
+        command_buffer.endRendering();
+    });
+
+    // Barriers and layout transitions are derived from the declared usages
+    render_graph.execute(command_buffer, &gpu_profiler);
+
+    gpu_profiler.endZone(command_buffer, frame_zone);
+    command_buffer.end();
 
 }
 
@@ -509,14 +1257,42 @@ void Engine::recordCommandBuffer(uint32_t image_index)
 
 void Engine::cleanup(){
     std::cout << "\nCLEANING UP RESOURCES..." << std::endl;
+    // Headless views point at color_image, drop them first
+    if(headless){
+        swapchain.image_views.clear();
+    }
+
     // Destroying the images -> this is needed since we need to destroy the allocator
+    retired_swapchains.clear();
     color_image.~AllocatedImage();
-    depth_image.~AllocatedImage();
+    transient_allocator.destroy();
+
+    if(!trace_path.empty()){
+        Profiler::writeChromeTrace(trace_path);
+    }
+    frame_pacer.printReport();
+    gpu_profiler.printReport();
+    gpu_profiler.writeCSV(GPU_TIMINGS_PATH);
+    gpu_profiler.destroy();
+    pipeline_compiler.destroy();
+    pipeline_tickets.clear();
+    retired_pipelines.clear();
+    pipeline_cache.save(pipeline_builder.get_creation_time());
+    pipeline_cache.destroy();
+    shader_library.destroy();
+    descriptor_heap.destroy();
 
     // Destroying the gameobject buffers
-    objects.clear();
-    ubo_camera_mapped.clear();
-    ubo_objects_mapped.clear();
+    upload_queue.destroy();
+    timeline.destroy();
+    jobs.destroy();
+    world.clear();
+    draw_meshes.clear();
+    mesh_registry.destroy();
+    geometry.destroy();
+    frame_allocator.destroy();
+    indirect_buffer = AllocatedBuffer();
+    visible_buffer = AllocatedBuffer();
     
 
     // Destroying the allocator
@@ -10,6 +10,24 @@
 #include "pipeline.hpp"
 #include "gameobject.hpp"
 #include "camera.hpp"
+#include "frameallocator.hpp"
+#include "culling.hpp"
+#include "uploadqueue.hpp"
+#include "geometrybuffer.hpp"
+#include "meshregistry.hpp"
+#include "ecs.hpp"
+#include "components.hpp"
+#include "systems.hpp"
+#include "jobsystem.hpp"
+#include "pipelinecache.hpp"
+#include "shaderlibrary.hpp"
+#include "gpuprofiler.hpp"
+#include "cpuprofiler.hpp"
+#include "framepacer.hpp"
+#include "timeline.hpp"
+#include "descriptorheap.hpp"
+#include "rendergraph.hpp"
+#include "transientallocator.hpp"
 
 
 
@@ -30,6 +48,17 @@ public:
 
     // Entry point of the engine. Initialize window and Vulkan components
     void init(const std::string title, uint32_t &w, uint32_t &h);
+
+    // Switches the engine to offscreen rendering. Must be called before init. Renders frame_count frames into color_image
+    // without window, surface or swapchain, and optionally writes the last frame to readback_path (PPM)
+    void setHeadless(uint32_t frame_count, std::string readback_path = "");
+
+    // Turns on the CPU profiler. The trace is written to trace_path at exit and when P is pressed
+    void setProfiling(std::string trace_path);
+
+    // Caps the frame rate (0 for no cap). With align_present the period snaps to the display refresh and follows the
+    // measured present times
+    void setFrameRate(uint32_t fps, bool align_present = false);
     
     // Closing functions: cleans the non-raii resources
     virtual void cleanup();
@@ -39,7 +68,7 @@ public:
 
 protected:
     // Window variables
-    GLFWwindow * window;
+    GLFWwindow * window = nullptr;
     std::string title;
     uint32_t win_width;
     uint32_t win_height;
@@ -58,40 +87,131 @@ protected:
     vk::raii::PhysicalDevice physical_device = nullptr;
     vk::raii::Device logical_device = nullptr;
     QueuePool queue_pool;
+    Timeline timeline; // One timeline semaphore per queue: frames in flight, uploads and retired resources all wait on it
+    UploadQueue upload_queue; // Batched buffer uploads on the transfer queue
+    GeometryBuffer geometry; // Vertices and indices of every mesh
+    const uint32_t MAX_GEOMETRY_VERTICES = 1 << 20;
+    const uint32_t MAX_GEOMETRY_INDICES = 1 << 22;
+    MeshRegistry mesh_registry; // Deduplicated meshes inside geometry
 
     // Swapchain related components
     SwapchainBundle swapchain;
+    // State the render target is left in at the end of the frame, and the later use it is made visible to
+    ImageState target_final_state{vk::ImageLayout::ePresentSrcKHR, vk::PipelineStageFlagBits2::eBottomOfPipe, vk::AccessFlagBits2::eNone};
+    bool swapchain_dirty = false; // Resized, out of date or suboptimal: recreated before the next acquire
+    bool fullscreen = false;
+    std::array<int, 4> windowed_rect{}; // Position and size to go back to when leaving fullscreen
+
+    // Replaced swapchains, with the graphics submission after which nothing uses them
+    struct RetiredSwapchain{
+        TimelinePoint last_use;
+        SwapchainBundle swapchain;
+        std::vector<vk::raii::Semaphore> semaphores; // Acquire and present semaphores of the old images
+    };
+    std::vector<RetiredSwapchain> retired_swapchains;
+
+    // Headless components
+    bool headless = false;
+    uint32_t headless_frames = 0;
+    std::string readback_path;
+
+    // CPU profiling components
+    std::string trace_path; // Chrome trace output, empty when not profiling
 
     // Memory allocator components
     VmaAllocator vma_allocator;
 
     // Images components
     vk::SampleCountFlagBits msaa_samples = vk::SampleCountFlagBits::e1;
-    AllocatedImage color_image; // The image we write onto
-    AllocatedImage depth_image;
+    AllocatedImage color_image; // Render target when headless
+    vk::Format depth_format = vk::Format::eUndefined;
+    TransientAllocator transient_allocator; // Memory of the images created by the render graph, aliased across its passes
 
     // Pipeline components
     PipelineBuilder pipeline_builder;
+    PipelineCache pipeline_cache; // Compiled pipelines kept between runs
+    const std::string PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+    ShaderLibrary shader_library; // Every shader module, shared by the pipelines using the same SPIR-V
+    DescriptorHeap descriptor_heap; // Bindless set 0 of every raster pipeline, bound once per command buffer
+    const std::string SHADER_CACHE_DIRECTORY = "shader_cache"; // SPIR-V of the define variants
+    bool show_depth = false; // Draws with the SHOW_DEPTH variant of the fragment shader, toggled with V
     std::vector<RasterPipelineBundle> raster_pipelines;
-    std::vector<Gameobject> objects;
-    std::vector<std::vector<MappedUBO>> ubo_objects_mapped;
-    std::map<RasterPipelineBundle *, std::vector<Gameobject *>> pip_to_obj; // This allows me to connect all the objects using the same pipeline
+    PipelineCompiler pipeline_compiler; // Creates pipelines off the render thread
+    std::vector<PipelineTicket> pipeline_tickets; // Per raster pipeline: the pipeline still compiling for it, if any
+    int32_t fallback_pipeline = 0; // Raster pipeline drawn in place of one that is not compiled yet, -1 skips those draws
+    std::vector<std::pair<TimelinePoint, vk::raii::Pipeline>> retired_pipelines; // Replaced pipelines and the last submission using them
+    std::vector<MeshHandle> draw_meshes; // Mesh drawn by each raster pipeline
+
+    // Entity components
+    ECS::World world; // Scene entities. The ones with RenderInfo are drawn by raster_pipelines[RenderInfo::draw]
+
+    // Worker threads for the per-frame object work
+    JobSystem jobs;
+    std::vector<ECS::ChunkRef> upload_chunks; // Chunks gathered this frame (upload or CPU culling) and where their instances start
+    std::vector<uint32_t> upload_offsets;
+    std::vector<vk::CommandBuffer> secondary_handles; // Secondary buffers executed this frame, in draw order
+
+    // Per-frame data components
+    FrameAllocator frame_allocator; // Camera and object data of every frame
+    vk::DeviceAddress frame_buffer_address = 0; // GPU pointer to frame_allocator's buffer, draws reach allocations at an offset from it
+    uint32_t max_objects = 0; // Number of model matrices reserved per frame
+    vk::DescriptorBufferInfo camera_buffer_info; // Descriptor ranges inside frame_allocator
+    vk::DescriptorBufferInfo objects_buffer_info;
+    DrawPushConstants draw_constants; // Addresses of the camera and objects of the current frame, pushed to every raster pipeline
+
+    // GPU culling components. Used when the device supports drawIndirectCount
+    bool gpu_culling = false;
+    const uint32_t MAX_CULL_DRAWS = 64; // Draw templates reserved per frame in frame_allocator
+    const uint32_t CULL_WORKGROUP_SIZE = 64; // Specialization constant 0 of cull.comp
+    ComputePipelineBundle cull_pipeline;
+    AllocatedBuffer indirect_buffer; // Per frame: draw count followed by one CullDraw per raster pipeline
+    AllocatedBuffer visible_buffer; // Per frame: model matrices of the instances that survived culling, grouped by draw
+    vk::DeviceSize indirect_frame_size = 0;
+    vk::DeviceSize visible_frame_size = 0;
+    vk::DescriptorBufferInfo draw_ids_buffer_info;
+    vk::DescriptorBufferInfo indirect_buffer_info;
+    vk::DescriptorBufferInfo visible_buffer_info;
+    vk::DeviceAddress visible_buffer_address = 0; // Draws read the culling output through it, nothing is rebound between the passes
+    std::vector<CullDraw> cull_draws; // Draw templates, one per raster pipeline
+    uint32_t cull_object_count = 0; // Instances written to the culling pass this frame
+    std::vector<uint32_t> cull_dynamic_offsets; // Offsets of the current frame for the culling pass
+    uint32_t cull_template_offset = 0; // Where the draw templates of the current frame live in frame_allocator
+
+    // CPU culling components. Used when GPU culling is not available
+    Culling::SphereBatch cull_spheres; // World bounding spheres of the instances of one pipeline
+    std::vector<const glm::mat4 *> cull_models; // Model matrix and draw of each sphere in cull_spheres
+    std::vector<uint32_t> cull_draw_ids;
+    std::vector<uint32_t> cull_visible; // Indices of the visible instances inside cull_spheres
+    std::vector<uint32_t> draw_first_instance; // Per raster pipeline: where its visible matrices start and how many there are
+    std::vector<uint32_t> draw_instance_count;
+    const uint32_t PACK_BLOCK_SIZE = 4096; // Visible instances packed per task
+    std::vector<uint32_t> pack_offsets; // Per block of cull_visible and raster pipeline: where the block writes its matrices
+    Culling::Stats culling_stats; // Last frame
 
     // Synchronization components
+    // Presentation only takes binary semaphores, everything else goes through timeline
     uint32_t current_frame = 0;
-    std::vector<vk::raii::Semaphore> present_complete_semaphores; // Used to synchronize the images being actually displayed
-    uint32_t present_semaphore_index = 0;
-    std::vector<vk::raii::Semaphore> render_finished_semaphores; // Used to synchronize operations on frames by the GPU before presenting them
-    std::vector<vk::raii::Fence> in_flight_fences; // Used to synchronize operations on the CPU
+    std::vector<vk::raii::Semaphore> present_complete_semaphores; // Per frame in flight: signaled by the acquire, waited by the submission
+    std::vector<vk::raii::Semaphore> render_finished_semaphores; // Per swapchain image: signaled by the submission, waited by the present
+    std::vector<TimelinePoint> frame_done; // Per frame in flight: graphics submission of its last use
 
     // FPS tracker components
     float time = 0.0;
     std::chrono::_V2::system_clock::time_point prev_time; 
-    uint32_t target_fps = 0;
+    FramePacer frame_pacer; // Frame rate cap and frame interval jitter
+    float cpu_time = 0.0; // CPU cost of the last frame, without the frame wait
+    float title_timer = 0.f; // ms since the window title was last updated
+    const float TITLE_INTERVAL = 250.f; // ms between window title updates
+
+    // Passes of the frame, their barriers are generated from what each pass reads and writes
+    RenderGraph render_graph;
+
+    // GPU profiling components
+    GpuProfiler gpu_profiler; // Per-pass GPU timings
+    const std::string GPU_TIMINGS_PATH = "gpu_timings.csv"; // Written at exit
 
     // Camera components
     Camera camera;
-    std::vector<MappedUBO> ubo_camera_mapped;
 
     // Input variables
     std::map<int, InputState> inputs;
@@ -129,8 +249,18 @@ protected:
     void createSurface();
     // Initializes Pipelines and scene objects
     virtual void createInitResources();
+    // Initializes the per-frame allocator with room for the camera and max_objects model matrices
+    void createFrameAllocator(uint32_t max_objects);
+    // Initializes the culling compute pipeline and the indirect buffers. Needs raster_pipelines and draw_meshes
+    void createCullingResources();
     // Initializes Synchronization objects
     void createSyncObjects();
+    // Initializes the present semaphores, one per swapchain image
+    void createSwapchainSemaphores();
+    // Prints the pipeline creation time of this run next to the one of the last cold run
+    void reportPipelineCreation();
+    // Creates color_image at the swapchain extent and uses it as the only render target when running headless
+    void createHeadlessTarget();
 
 
     // --- RUN FUNCTIONS ---
@@ -141,11 +271,60 @@ protected:
     // Main functions to register commands to the GPU
     virtual void recordCommandBuffer(uint32_t image_index);
 
+    /**
+     * Splits draws [0, draw_count) in contiguous ranges, records each range into a secondary command buffer on the job system
+     * and executes them on primary in range order. Must be called inside a rendering block begun with
+     * vk::RenderingFlagBits::eContentsSecondaryCommandBuffers. record(command_buffer, begin, end) records the draws of one range,
+     * viewport and scissor are already set
+     */
+    void recordSecondaryDraws(vk::raii::CommandBuffer &primary, uint32_t draw_count,
+                              const std::function<void(vk::raii::CommandBuffer &, uint32_t, uint32_t)> &record);
+
+    // Adds the passes resetting the indirect draws from their templates and running the frustum culling dispatch,
+    // which fills indirect_buffer and visible_buffer for this frame
+    void addCullingPasses(ResourceHandle frame_data, ResourceHandle indirect, ResourceHandle visible);
+    // Culls the drawn entities on the CPU and packs the visible matrices per raster pipeline into models. Gather and packing
+    // are split across the job system
+    void cullObjects(glm::mat4 * models);
+    // Spawns a drawn entity. Throws when the per-frame matrix storage is full
+    ECS::Entity spawnObject(const Transform &transform, const Velocity &velocity, uint32_t draw);
+
+    // Sets up pipeline_builder for a raster pipeline drawing into the swapchain format. It reads its per-frame data
+    // through the device addresses in DrawPushConstants. With fragment_defines, fragment_shader_path is the GLSL source
+    // of a define variant
+    void configureRasterPipeline(const std::string &name, const std::string &vertex_shader_path, const std::string &fragment_shader_path,
+                                 const std::vector<std::string> &fragment_defines = {});
+    // Compiles new shaders for a raster pipeline in the background. The draw keeps its current pipeline until then
+    void setRasterShaders(uint32_t draw, const std::string &vertex_shader_path, const std::string &fragment_shader_path,
+                          const std::vector<std::string> &fragment_defines = {});
+    // Installs the pipelines compiled since the last frame and frees the replaced ones no frame in flight uses anymore
+    void updatePipelines();
+    // Pipeline to bind for a raster pipeline: its own, the fallback while it compiles, or nullptr to skip the draw
+    const vk::raii::Pipeline *getDrawPipeline(uint32_t draw) const;
+
     // main function for rendering
     void drawFrame();
+    // Replaces the swapchain for the current framebuffer size without waiting for the device. Returns false while minimized
+    bool recreateSwapchain();
+    // Frees the retired swapchains whose last submission is done, and recycles the released heap slots
+    void releaseRetiredResources();
+    // Toggles fullscreen with F11
+    void processWindowInput();
+    // Shows FPS and GPU frame time in the window title, a few times per second
+    void updateWindowTitle();
+    // Writes the CPU profiler trace when P is pressed
+    void processProfilerInput();
+
+    // Loop function for headless mode. Draws a fixed number of frames and reports their cost
+    void runHeadless();
+
+    // Copies color_image back to the host and writes it as a PPM file
+    void readbackColorImage(const std::string &path);
 
     // Input function. Maps inputs to a dictionary for later usage
     static void recordInput(GLFWwindow *window, int key, int scancode, int action, int mods);
+    // Marks the swapchain for recreation when the framebuffer changes size
+    static void recordResize(GLFWwindow *window, int width, int height);
 
     // Actual function that process keyboard input accordingly
     virtual void processInput();
@@ -0,0 +1,66 @@
+#include "frameallocator.hpp"
+
+void FrameAllocator::create(vk::DeviceSize frame_size, int max_frames_in_flight, vk::BufferUsageFlags usage, vk::DeviceSize alignment, VmaAllocator &vma_allocator)
+{
+    this -> alignment = alignment;
+    this -> frame_size = alignUp(frame_size, alignment);
+
+    // Host visible buffers are created persistently mapped by Device::createBuffer
+    buffer = Device::createBuffer(
+        this -> frame_size * max_frames_in_flight,
+        usage,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+        "Frame Allocator Buffer",
+        vma_allocator
+    );
+    mapped = static_cast<char *>(buffer.info.pMappedData);
+    if(!mapped){
+        throw std::runtime_error("Frame allocator buffer is not host mapped!");
+    }
+
+    head = 0;
+    frame_end = this -> frame_size;
+
+    std::cout << "Created Frame Allocator: " << max_frames_in_flight << " x " << this -> frame_size << " bytes" << std::endl;
+}
+
+void FrameAllocator::beginFrame(int frame)
+{
+    head = frame * frame_size;
+    frame_end = head + frame_size;
+}
+
+FrameAllocation FrameAllocator::allocate(vk::DeviceSize size)
+{
+    if(head + size > frame_end){
+        std::stringstream ss;
+        ss << "FrameAllocator out of space: requested " << size << " bytes, " << (frame_end - head) << " left in this frame";
+        throw std::runtime_error(ss.str());
+    }
+
+    FrameAllocation allocation;
+    allocation.data = mapped + head;
+    allocation.offset = static_cast<uint32_t>(head);
+    allocation.size = size;
+
+    head = alignUp(head + size, alignment);
+
+    return allocation;
+}
+
+vk::DescriptorBufferInfo FrameAllocator::getDescriptorInfo(vk::DeviceSize range) const
+{
+    return vk::DescriptorBufferInfo{buffer.buffer, 0, range};
+}
+
+void FrameAllocator::destroy()
+{
+    mapped = nullptr;
+    buffer = AllocatedBuffer();
+}
+
+vk::DeviceSize FrameAllocator::getRequiredAlignment(const vk::raii::PhysicalDevice &physical_device)
+{
+    vk::PhysicalDeviceLimits limits = physical_device.getProperties().limits;
+    return std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+}
\ No newline at end of file
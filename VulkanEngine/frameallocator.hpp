@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include "device.hpp"
+
+// Sub-allocation handed out by the FrameAllocator
+struct FrameAllocation{
+    void * data = nullptr; // Host pointer to write into
+    uint32_t offset = 0; // Offset from the start of the buffer, to be used as dynamic offset
+    vk::DeviceSize size = 0;
+};
+
+/**
+ * Linear allocator for per-frame data.
+ * One persistently mapped buffer is split in a region per frame in flight. Each frame its region is reset
+ * and sub-allocated linearly, and allocations are addressed through dynamic offsets, so a single descriptor
+ * covers every frame and every allocation. Created with eShaderDeviceAddress, an allocation is also reachable at
+ * the buffer's device address plus its offset.
+ */
+class FrameAllocator{
+public:
+    // Creates the buffer. frame_size is the space each frame can sub-allocate
+    void create(vk::DeviceSize frame_size, int max_frames_in_flight, vk::BufferUsageFlags usage, vk::DeviceSize alignment, VmaAllocator &vma_allocator);
+
+    // Resets the region of the given frame. Its previous content must not be in use by the GPU anymore
+    void beginFrame(int frame);
+
+    // Reserves size bytes in the current frame region
+    FrameAllocation allocate(vk::DeviceSize size);
+
+    // Descriptor info covering range bytes from the start of the buffer, to be used with dynamic descriptors
+    vk::DescriptorBufferInfo getDescriptorInfo(vk::DeviceSize range) const;
+
+    const AllocatedBuffer &getBuffer() const { return buffer; }
+    vk::DeviceSize getAlignment() const { return alignment; }
+
+    // Releases the buffer. Needed before destroying the allocator
+    void destroy();
+
+    // Helper function returning the offset alignment valid for both uniform and storage dynamic descriptors
+    static vk::DeviceSize getRequiredAlignment(const vk::raii::PhysicalDevice &physical_device);
+
+    // Helper function to round size up to a multiple of alignment (power of two)
+    static vk::DeviceSize alignUp(vk::DeviceSize size, vk::DeviceSize alignment){
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+private:
+    AllocatedBuffer buffer;
+    char * mapped = nullptr;
+
+    vk::DeviceSize frame_size = 0;
+    vk::DeviceSize alignment = 1;
+    vk::DeviceSize head = 0; // Next free byte
+    vk::DeviceSize frame_end = 0; // End of the current frame region
+};
\ No newline at end of file
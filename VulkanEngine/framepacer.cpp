@@ -0,0 +1,168 @@
+#include "framepacer.hpp"
+
+#include <cmath>
+#include <iomanip>
+#include <thread>
+
+namespace{
+    float toMs(FramePacer::Clock::duration duration)
+    {
+        return std::chrono::duration<float, std::milli>(duration).count();
+    }
+
+    FramePacer::Clock::duration fromMs(float ms)
+    {
+        return std::chrono::duration_cast<FramePacer::Clock::duration>(std::chrono::duration<float, std::milli>(ms));
+    }
+}
+
+void FramePacer::setTargetFPS(uint32_t fps)
+{
+    target_fps = fps;
+    updatePeriod();
+}
+
+void FramePacer::setDisplayRefresh(float hz)
+{
+    display_period_ms = hz > 0.f ? 1000.f / hz : 0.f;
+    updatePeriod();
+}
+
+void FramePacer::setPresentAlignment(bool enabled)
+{
+    align_present = enabled;
+    updatePeriod();
+}
+
+void FramePacer::wait()
+{
+    Clock::time_point now = Clock::now();
+
+    if(period_ms > 0.f){
+        // More than a frame late: start over from now instead of rushing the missed frames out
+        if(deadline == Clock::time_point{} || now - deadline > fromMs(period_ms)){
+            deadline = now;
+        }
+
+        // Coarse sleep, the OS wakes the thread late by an amount that varies
+        Clock::time_point wake_up = deadline - fromMs(spin_margin_ms);
+        if(now < wake_up){
+            std::this_thread::sleep_until(wake_up);
+            float oversleep = toMs(Clock::now() - wake_up);
+
+            // Grow the margin at once on a late wake up, shrink it slowly when the scheduler behaves
+            float wanted = oversleep * 1.25f + 0.05f;
+            spin_margin_ms = wanted > spin_margin_ms ? wanted : spin_margin_ms * 0.99f + wanted * 0.01f;
+            spin_margin_ms = std::clamp(spin_margin_ms, 0.05f, 4.f);
+        }
+
+        // Spin for the last stretch
+        while(Clock::now() < deadline);
+
+        deadline += fromMs(period_ms);
+    }
+
+    frame_start = Clock::now();
+    frame_intervals.push(frame_start);
+}
+
+void FramePacer::markPresent()
+{
+    Clock::time_point now = Clock::now();
+    present_intervals.push(now);
+
+    if(frame_start != Clock::time_point{}){
+        frame_lead_ms = frame_lead_ms * 0.9f + toMs(now - frame_start) * 0.1f;
+    }
+
+    // Start the next frame early enough for its present to land one period after this one
+    if(align_present && period_ms > 0.f){
+        deadline = now + fromMs(period_ms - frame_lead_ms);
+    }
+}
+
+void FramePacer::printReport() const
+{
+    IntervalStats frames = getFrameStats();
+    if(frames.samples == 0){
+        return;
+    }
+
+    std::cout << "Frame pacing: ";
+    if(period_ms > 0.f){
+        std::cout << target_fps << " FPS target, " << period_ms << " ms period" << (align_present && display_period_ms > 0.f ? " (aligned to present)" : "");
+    }
+    else{
+        std::cout << "unlimited";
+    }
+    std::cout << std::endl;
+
+    auto printStats = [](const char * name, const IntervalStats &stats){
+        std::cout << "  " << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(3)
+                  << " avg " << stats.avg << "  jitter " << stats.stddev << "  p99 " << stats.p99 << "  max " << stats.max << std::endl;
+    };
+    printStats("frame interval", frames);
+    IntervalStats presents = getPresentStats();
+    if(presents.samples > 0){
+        printStats("present interval", presents);
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+void FramePacer::IntervalHistory::push(Clock::time_point now)
+{
+    if(last != Clock::time_point{}){
+        if(samples.empty()){
+            samples.resize(WINDOW_SIZE, 0.f);
+        }
+        samples[next] = toMs(now - last);
+        next = (next + 1) % WINDOW_SIZE;
+        count = std::min(count + 1, WINDOW_SIZE);
+    }
+    last = now;
+}
+
+void FramePacer::updatePeriod()
+{
+    deadline = Clock::time_point{}; // The next frame starts a new schedule
+
+    if(target_fps == 0){
+        period_ms = 0.f;
+        return;
+    }
+
+    period_ms = 1000.f / target_fps;
+    if(align_present && display_period_ms > 0.f){
+        // A period between two refreshes alternates short and long frames on screen, take the closest multiple
+        period_ms = std::max(1.f, std::round(period_ms / display_period_ms)) * display_period_ms;
+    }
+}
+
+FramePacer::IntervalStats FramePacer::computeStats(const IntervalHistory &history)
+{
+    IntervalStats stats;
+    stats.samples = history.count;
+    if(history.count == 0){
+        return stats;
+    }
+
+    std::vector<float> sorted(history.samples.begin(), history.samples.begin() + history.count);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for(float sample : sorted){
+        sum += sample;
+    }
+    double avg = sum / sorted.size();
+
+    double variance = 0.0;
+    for(float sample : sorted){
+        variance += (sample - avg) * (sample - avg);
+    }
+
+    stats.avg = static_cast<float>(avg);
+    stats.stddev = static_cast<float>(std::sqrt(variance / sorted.size()));
+    stats.p99 = sorted[std::min(static_cast<size_t>(sorted.size() * 0.99), sorted.size() - 1)];
+    stats.max = sorted.back();
+    return stats;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+/**
+ * Frame rate limiter driven by absolute deadlines.
+ * Every frame starts at the previous deadline plus one period, so oversleeping one frame does not push the next ones
+ * back. The wait sleeps until shortly before the deadline and spins for the rest; the spin margin follows the
+ * oversleep the OS scheduler actually shows. With present alignment the period is snapped to a multiple of the display
+ * refresh and each deadline is re-anchored on the measured present times instead of the pacer's own clock.
+ * Frame start and present intervals are kept in a rolling window for jitter statistics.
+ */
+class FramePacer{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Rolling statistics of the intervals between two events (ms)
+    struct IntervalStats{
+        uint32_t samples = 0;
+        float avg = 0.f;
+        float stddev = 0.f; // The jitter
+        float p99 = 0.f;
+        float max = 0.f;
+    };
+
+    static const uint32_t WINDOW_SIZE = 512; // Intervals kept
+
+    // 0 disables the limiter. Jitter is still measured
+    void setTargetFPS(uint32_t fps);
+
+    // Refresh rate of the display, used by present alignment (0 if unknown)
+    void setDisplayRefresh(float hz);
+
+    // Snap the period to the display refresh and follow the measured present times
+    void setPresentAlignment(bool enabled);
+
+    // Blocks until the next frame is due
+    void wait();
+
+    // Call right after the frame was handed to the presentation engine
+    void markPresent();
+
+    uint32_t getTargetFPS() const { return target_fps; }
+    float getPeriod() const { return period_ms; } // Effective period (ms), 0 when unlimited
+
+    IntervalStats getFrameStats() const { return computeStats(frame_intervals); }
+    IntervalStats getPresentStats() const { return computeStats(present_intervals); }
+
+    // Prints the target and the jitter of frame starts and presents
+    void printReport() const;
+
+private:
+    struct IntervalHistory{
+        std::vector<float> samples; // Ring of WINDOW_SIZE intervals
+        uint32_t next = 0;
+        uint32_t count = 0;
+        Clock::time_point last{}; // Last event, epoch when there was none yet
+
+        void push(Clock::time_point now);
+    };
+
+    uint32_t target_fps = 0;
+    float display_period_ms = 0.f;
+    bool align_present = false;
+    float period_ms = 0.f;
+
+    Clock::time_point deadline{}; // Start of the next frame, epoch when not started
+    float spin_margin_ms = 1.f; // Sleep stops this long before the deadline
+    float frame_lead_ms = 0.f; // Average time from frame start to present, used by present alignment
+    Clock::time_point frame_start{};
+
+    IntervalHistory frame_intervals;
+    IntervalHistory present_intervals;
+
+    void updatePeriod();
+    static IntervalStats computeStats(const IntervalHistory &history);
+};
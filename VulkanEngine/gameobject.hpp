@@ -3,6 +3,7 @@
 #include "../Helpers/GeneralLibraries.hpp"
 
 #include "device.hpp"
+#include "meshregistry.hpp"
 
 class Gameobject{
 public:
@@ -30,26 +31,27 @@ public:
 
     // Enable moving
     Gameobject(Gameobject&& other) noexcept 
-        : vertices(std::move(other.vertices)), 
-          vertex_buffer(std::move(other.vertex_buffer)),
-          indices(std::move(other.indices)),
-          index_buffer(std::move(other.index_buffer)),
+        : mesh_data(std::move(other.mesh_data)),
+          mesh(std::move(other.mesh)),
           position(other.position),
           rotation(other.rotation),
           scale(other.scale),
           dis_speed(other.dis_speed),
           rot_speed(other.rot_speed),
           scale_speed(other.scale_speed),
+          local_sphere(other.local_sphere),
+          local_min(other.local_min),
+          local_max(other.local_max),
+          world_sphere(other.world_sphere),
+          world_min(other.world_min),
+          world_max(other.world_max),
           ubo(std::move(other.ubo)) {
     }
 
     Gameobject& operator=(Gameobject&& other) noexcept {
         if (this != &other) {
-            vertices = std::move(other.vertices);
-            vertex_buffer = std::move(other.vertex_buffer);
-
-            indices = std::move(other.indices);
-            index_buffer = std::move(other.index_buffer);
+            mesh_data = std::move(other.mesh_data);
+            mesh = std::move(other.mesh);
 
             position = other.position;
             scale = other.scale;
@@ -57,6 +59,12 @@ public:
             dis_speed = other.dis_speed;
             rot_speed = other.rot_speed;
             scale_speed = other.scale_speed;
+            local_sphere = other.local_sphere;
+            local_min = other.local_min;
+            local_max = other.local_max;
+            world_sphere = other.world_sphere;
+            world_min = other.world_min;
+            world_max = other.world_max;
 
             ubo = std::move(other.ubo);
         }
@@ -64,9 +72,13 @@ public:
     }
 
 
-    // Initializes the object
-    virtual void start(VmaAllocator& vma_allocator, vk::raii::Device& logical_device, QueuePool& queue_pool){
-        loadBuffers(vma_allocator, logical_device, queue_pool);
+    // Initializes the object. Its mesh_data is handed to the registry, which uploads it with the next upload_queue.flush()
+    // unless the same geometry is already loaded. Objects given a mesh with setMesh() skip the loading
+    virtual void start(MeshRegistry& mesh_registry){
+        if(!mesh.isValid()){
+            setMesh(mesh_registry.load(std::move(mesh_data)));
+            mesh_data = MeshData();
+        }
     }
 
     // Updates the object
@@ -91,19 +103,45 @@ public:
 
 
     uint32_t getVertexSize(){
-        return vertices.size();
+        return mesh.getRange().vertex_count;
     }
 
     uint32_t getIndexSize(){
-        return indices.size();
+        return mesh.getRange().index_count;
     }
 
-    const vk::Buffer& getVertexBuffer(){
-        return vertex_buffer.buffer;
+    // Shares an already loaded mesh and takes its bounds
+    void setMesh(MeshHandle mesh){
+        this -> mesh = std::move(mesh);
+        local_sphere = this -> mesh.getLocalSphere();
+        local_min = this -> mesh.getLocalMin();
+        local_max = this -> mesh.getLocalMax();
+        dirty_model = true; // world bounds need to follow
     }
 
-    const vk::Buffer& getIndexBuffer(){
-        return index_buffer.buffer;
+    const MeshHandle& getMesh() const{
+        return mesh;
+    }
+
+    // Bounding sphere of the mesh in local space: center xyz, radius w
+    const glm::vec4& getLocalSphere() const{
+        return local_sphere;
+    }
+
+    // Bounding volumes in world space, follow the model matrix
+    const glm::vec4& getWorldSphere(){
+        getModelMat();
+        return world_sphere;
+    }
+
+    const glm::vec3& getWorldMin(){
+        getModelMat();
+        return world_min;
+    }
+
+    const glm::vec3& getWorldMax(){
+        getModelMat();
+        return world_max;
     }
 
     virtual const glm::mat4 &getModelMat(){
@@ -122,6 +160,8 @@ public:
                 model = glm::rotate(model, glm::radians(rotation.z), glm::vec3(0, 0, 1));
             }
             model = glm::scale(model, scale);
+
+            updateWorldBounds();
         }
         return model;
     }
@@ -137,10 +177,8 @@ public:
     }
 
 protected:
-    std::vector<Vertex> vertices;
-    AllocatedBuffer vertex_buffer;
-    std::vector<uint32_t> indices;
-    AllocatedBuffer index_buffer;
+    MeshData mesh_data; // Geometry to load in start(), dropped afterwards
+    MeshHandle mesh;
 
     // Spatial information
     glm::vec3 position;
@@ -149,36 +187,33 @@ protected:
     glm::mat4 model;
     UniformBufferGameObjects ubo;
     bool dirty_model = true; // Tracks whether model needs to be recalculated or not
+    glm::vec4 local_sphere = glm::vec4(0.f); // Bounding sphere of the mesh, used for culling
+    glm::vec3 local_min = glm::vec3(0.f); // Bounding box of the mesh
+    glm::vec3 local_max = glm::vec3(0.f);
+    glm::vec4 world_sphere = glm::vec4(0.f); // Bounding volumes after the model matrix
+    glm::vec3 world_min = glm::vec3(0.f);
+    glm::vec3 world_max = glm::vec3(0.f);
 
     // Velocity information
     glm::vec3 dis_speed; // Displacement speed
     glm::vec3 rot_speed; // Rotational speed
     glm::vec3 scale_speed; // Scale change speed
 
-    // loads the necessary buffers for the object
-    void loadBuffers(VmaAllocator &vma_allocator, vk::raii::Device &logical_device, QueuePool &queue_pool){
-        vk::DeviceSize vertex_size = sizeof(Vertex) * vertices.size();
-        vk::DeviceSize index_size = sizeof(uint32_t) * indices.size();
-        vk::DeviceSize total_size = vertex_size + index_size;
-
-        AllocatedBuffer staging_buffer = Device::createBuffer(total_size, vk::BufferUsageFlagBits::eTransferSrc,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, "vertex+indices staging buffer", vma_allocator);
-
-        void * data;
-        vmaMapMemory(vma_allocator, staging_buffer.allocation, &data);
-        memcpy(data, vertices.data(), (size_t)vertex_size);
-        memcpy((char *)data + vertex_size, indices.data(), (size_t)index_size);
-        vmaUnmapMemory(vma_allocator, staging_buffer.allocation);
-
-        vertex_buffer = Device::createBuffer(vertex_size, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
-            vk::MemoryPropertyFlagBits::eDeviceLocal, "vertex buffer", vma_allocator);
-
-        Device::copyBuffer(staging_buffer, vertex_buffer, vertex_size, logical_device, queue_pool, 0);
-
-        index_buffer = Device::createBuffer(index_size, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
-            vk::MemoryPropertyFlagBits::eDeviceLocal, "index buffer", vma_allocator);
-
-        Device::copyBuffer(staging_buffer, index_buffer, index_size, logical_device, queue_pool, vertex_size);
+    // Transforms the local bounds with the current model matrix
+    void updateWorldBounds(){
+        // The sphere radius grows with the largest scale axis
+        glm::vec3 sphere_center = glm::vec3(model * glm::vec4(glm::vec3(local_sphere), 1.f));
+        float max_scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        world_sphere = glm::vec4(sphere_center, local_sphere.w * max_scale);
+
+        // The box extent is projected on the world axes through the absolute rotation-scale part
+        glm::vec3 box_center = glm::vec3(model * glm::vec4((local_min + local_max) * 0.5f, 1.f));
+        glm::vec3 box_extent = (local_max - local_min) * 0.5f;
+        glm::vec3 world_extent = glm::abs(glm::vec3(model[0])) * box_extent.x +
+                                 glm::abs(glm::vec3(model[1])) * box_extent.y +
+                                 glm::abs(glm::vec3(model[2])) * box_extent.z;
+        world_min = box_center - world_extent;
+        world_max = box_center + world_extent;
     }
 
 };
\ No newline at end of file
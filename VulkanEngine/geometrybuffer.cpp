@@ -0,0 +1,100 @@
+#include "geometrybuffer.hpp"
+
+void GeometryBuffer::create(uint32_t max_vertices, uint32_t max_indices, VmaAllocator &vma_allocator)
+{
+    vertex_buffer = Device::createBuffer(sizeof(Vertex) * max_vertices, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, "Geometry Vertex Buffer", vma_allocator);
+    index_buffer = Device::createBuffer(sizeof(uint32_t) * max_indices, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
+        vk::MemoryPropertyFlagBits::eDeviceLocal, "Geometry Index Buffer", vma_allocator);
+
+    // Blocks count elements, not bytes, so offsets can be used as draw parameters directly
+    VmaVirtualBlockCreateInfo block_info = {};
+    block_info.size = max_vertices;
+    VkResult r = vmaCreateVirtualBlock(&block_info, &vertex_block);
+    if(r != VK_SUCCESS){
+        throw std::runtime_error(std::string("vmaCreateVirtualBlock failed: ") + Device::VmaResultToString(r));
+    }
+
+    block_info.size = max_indices;
+    r = vmaCreateVirtualBlock(&block_info, &index_block);
+    if(r != VK_SUCCESS){
+        throw std::runtime_error(std::string("vmaCreateVirtualBlock failed: ") + Device::VmaResultToString(r));
+    }
+
+    std::cout << "Created Geometry Buffer: " << max_vertices << " vertices, " << max_indices << " indices" << std::endl;
+}
+
+MeshRange GeometryBuffer::allocate(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, UploadQueue &upload_queue,
+                                   UploadTicket *ticket)
+{
+    if(vertices.empty() || indices.empty()){
+        throw std::runtime_error("Can't allocate an empty mesh in the geometry buffer!");
+    }
+
+    MeshRange mesh;
+    VmaVirtualAllocationCreateInfo alloc_info = {};
+    VkDeviceSize vertex_offset;
+    VkDeviceSize first_index;
+
+    alloc_info.size = vertices.size();
+    if(vmaVirtualAllocate(vertex_block, &alloc_info, &mesh.vertex_allocation, &vertex_offset) != VK_SUCCESS){
+        throw std::runtime_error("Geometry buffer out of vertex space!");
+    }
+
+    alloc_info.size = indices.size();
+    if(vmaVirtualAllocate(index_block, &alloc_info, &mesh.index_allocation, &first_index) != VK_SUCCESS){
+        vmaVirtualFree(vertex_block, mesh.vertex_allocation);
+        throw std::runtime_error("Geometry buffer out of index space!");
+    }
+
+    mesh.vertex_offset = static_cast<int32_t>(vertex_offset);
+    mesh.first_index = static_cast<uint32_t>(first_index);
+    mesh.vertex_count = static_cast<uint32_t>(vertices.size());
+    mesh.index_count = static_cast<uint32_t>(indices.size());
+
+    upload_queue.uploadBuffer(vertices.data(), sizeof(Vertex) * vertices.size(), vertex_buffer, sizeof(Vertex) * vertex_offset,
+        vk::PipelineStageFlagBits2::eVertexAttributeInput, vk::AccessFlagBits2::eVertexAttributeRead);
+    UploadTicket index_ticket = upload_queue.uploadBuffer(indices.data(), sizeof(uint32_t) * indices.size(), index_buffer, sizeof(uint32_t) * first_index,
+        vk::PipelineStageFlagBits2::eIndexInput, vk::AccessFlagBits2::eIndexRead);
+    if(ticket){
+        *ticket = index_ticket;
+    }
+
+    return mesh;
+}
+
+void GeometryBuffer::free(MeshRange &mesh)
+{
+    // The blocks may already be gone when objects outlive the engine resources
+    if(vertex_block != VK_NULL_HANDLE && mesh.vertex_allocation != VK_NULL_HANDLE){
+        vmaVirtualFree(vertex_block, mesh.vertex_allocation);
+    }
+    if(index_block != VK_NULL_HANDLE && mesh.index_allocation != VK_NULL_HANDLE){
+        vmaVirtualFree(index_block, mesh.index_allocation);
+    }
+    mesh = MeshRange();
+}
+
+void GeometryBuffer::bind(vk::raii::CommandBuffer &command_buffer) const
+{
+    command_buffer.bindVertexBuffers(0, vertex_buffer.buffer, {0});
+    command_buffer.bindIndexBuffer(index_buffer.buffer, 0, vk::IndexType::eUint32);
+}
+
+void GeometryBuffer::destroy()
+{
+    // Live ranges are dropped with the blocks
+    if(vertex_block != VK_NULL_HANDLE){
+        vmaClearVirtualBlock(vertex_block);
+        vmaDestroyVirtualBlock(vertex_block);
+        vertex_block = VK_NULL_HANDLE;
+    }
+    if(index_block != VK_NULL_HANDLE){
+        vmaClearVirtualBlock(index_block);
+        vmaDestroyVirtualBlock(index_block);
+        index_block = VK_NULL_HANDLE;
+    }
+
+    vertex_buffer = AllocatedBuffer();
+    index_buffer = AllocatedBuffer();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include "device.hpp"
+#include "uploadqueue.hpp"
+
+// Range of a mesh inside the GeometryBuffer, ready to be used as draw parameters
+struct MeshRange{
+    uint32_t first_index = 0;
+    int32_t vertex_offset = 0;
+    uint32_t index_count = 0;
+    uint32_t vertex_count = 0;
+
+    VmaVirtualAllocation vertex_allocation = VK_NULL_HANDLE;
+    VmaVirtualAllocation index_allocation = VK_NULL_HANDLE;
+
+    bool isValid() const{
+        return vertex_allocation != VK_NULL_HANDLE && index_allocation != VK_NULL_HANDLE;
+    }
+};
+
+/**
+ * One device-local vertex buffer and one index buffer shared by every mesh.
+ * Ranges are handed out by two VMA virtual blocks measured in elements (vertices and indices), so meshes are
+ * drawn with firstIndex/vertexOffset and a whole frame binds the geometry once.
+ */
+class GeometryBuffer{
+public:
+    // Creates the buffers, sized for max_vertices vertices and max_indices indices
+    void create(uint32_t max_vertices, uint32_t max_indices, VmaAllocator &vma_allocator);
+
+    // Reserves the ranges of a mesh and queues the upload of its data. The ticket of the upload is written to ticket if given
+    MeshRange allocate(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, UploadQueue &upload_queue,
+                       UploadTicket *ticket = nullptr);
+
+    // Gives the ranges back. The GPU must not be using them anymore
+    void free(MeshRange &mesh);
+
+    // Binds the vertex and index buffers
+    void bind(vk::raii::CommandBuffer &command_buffer) const;
+
+    // Releases the buffers and the blocks. Needed before destroying the allocator
+    void destroy();
+
+private:
+    AllocatedBuffer vertex_buffer;
+    AllocatedBuffer index_buffer;
+    VmaVirtualBlock vertex_block = VK_NULL_HANDLE;
+    VmaVirtualBlock index_block = VK_NULL_HANDLE;
+};
@@ -0,0 +1,219 @@
+#include "gpuprofiler.hpp"
+
+#include <cstring>
+#include <iomanip>
+
+void GpuProfiler::create(const vk::raii::PhysicalDevice &physical_device, vk::raii::Device &logical_device, uint32_t graphics_family,
+                         uint32_t max_frames_in_flight)
+{
+    vk::PhysicalDeviceProperties properties = physical_device.getProperties();
+    uint32_t valid_bits = physical_device.getQueueFamilyProperties()[graphics_family].timestampValidBits;
+    if(valid_bits == 0 || properties.limits.timestampPeriod <= 0.f){
+        std::cout << "Timestamps not supported on the graphics queue, GPU profiler disabled" << std::endl;
+        enabled = false;
+        return;
+    }
+    timestamp_period = properties.limits.timestampPeriod;
+    timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+    vk::QueryPoolCreateInfo pool_info;
+    pool_info.queryType = vk::QueryType::eTimestamp;
+    pool_info.queryCount = MAX_ZONES * 2; // Begin and end of each zone
+
+    frames.clear();
+    for(uint32_t i = 0; i < max_frames_in_flight; i++){
+        FrameQueries frame;
+        frame.pool = vk::raii::QueryPool(logical_device, pool_info);
+        frame.names.reserve(MAX_ZONES);
+        frames.push_back(std::move(frame));
+    }
+    enabled = true;
+}
+
+void GpuProfiler::beginFrame(vk::raii::CommandBuffer &command_buffer, uint32_t frame)
+{
+    if(!enabled){
+        return;
+    }
+
+    current_frame = frame;
+    FrameQueries &queries = frames[frame];
+    if(queries.pending){
+        collect(queries);
+    }
+
+    command_buffer.resetQueryPool(*queries.pool, 0, MAX_ZONES * 2);
+    queries.names.clear();
+    queries.pending = true;
+}
+
+uint32_t GpuProfiler::beginZone(vk::raii::CommandBuffer &command_buffer, const char *name)
+{
+    if(!enabled){
+        return UINT32_MAX;
+    }
+
+    FrameQueries &queries = frames[current_frame];
+    if(queries.names.size() >= MAX_ZONES){
+        return UINT32_MAX; // Out of queries, the zone is not measured
+    }
+
+    uint32_t zone = static_cast<uint32_t>(queries.names.size());
+    queries.names.push_back(name);
+    command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, *queries.pool, zone * 2);
+    return zone;
+}
+
+void GpuProfiler::endZone(vk::raii::CommandBuffer &command_buffer, uint32_t zone)
+{
+    if(zone == UINT32_MAX){
+        return;
+    }
+    command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, *frames[current_frame].pool, zone * 2 + 1);
+}
+
+float GpuProfiler::getLast(const std::string &name) const
+{
+    for(const ZoneHistory &history : zones){
+        if(history.name == name){
+            return history.last;
+        }
+    }
+    return 0.f;
+}
+
+std::vector<GpuProfiler::ZoneStats> GpuProfiler::getStats() const
+{
+    std::vector<ZoneStats> stats;
+    for(const ZoneHistory &history : zones){
+        stats.push_back(computeStats(history));
+    }
+    return stats;
+}
+
+void GpuProfiler::printReport() const
+{
+    if(!enabled || zones.empty()){
+        return;
+    }
+
+    std::cout << "GPU timings (last " << WINDOW_SIZE << " frames, ms):" << std::endl;
+    for(const ZoneStats &stats : getStats()){
+        std::cout << "  " << std::left << std::setw(20) << stats.name << std::right << std::fixed << std::setprecision(3)
+                  << " min " << stats.min << "  avg " << stats.avg << "  p99 " << stats.p99 << "  max " << stats.max << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+
+    // Histogram of the first zone, the whole frame when the caller opens a zone around it
+    const ZoneHistory &frame = zones[0];
+    ZoneStats frame_stats = computeStats(frame);
+    const uint32_t BUCKETS = 10;
+    float width = (frame_stats.max - frame_stats.min) / BUCKETS;
+    if(frame.count == 0 || width <= 0.f){
+        return;
+    }
+
+    std::array<uint32_t, BUCKETS> counts{};
+    for(uint32_t i = 0; i < frame.count; i++){
+        uint32_t bucket = std::min(static_cast<uint32_t>((frame.samples[i] - frame_stats.min) / width), BUCKETS - 1);
+        counts[bucket]++;
+    }
+    uint32_t highest = *std::max_element(counts.begin(), counts.end());
+
+    std::cout << "Histogram of " << frame.name << ":" << std::endl;
+    for(uint32_t bucket = 0; bucket < BUCKETS; bucket++){
+        std::cout << "  " << std::fixed << std::setprecision(3) << std::setw(8) << frame_stats.min + width * bucket << " ms | "
+                  << std::string(counts[bucket] * 40 / highest, '#') << " " << counts[bucket] << std::endl;
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
+
+void GpuProfiler::writeCSV(const std::string &path) const
+{
+    if(!enabled){
+        return;
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if(!file.is_open()){
+        std::cout << "Failed to write GPU timings: " << path << std::endl;
+        return;
+    }
+
+    file << "zone,samples,min_ms,avg_ms,p99_ms,max_ms\n";
+    for(const ZoneStats &stats : getStats()){
+        file << stats.name << "," << stats.samples << "," << stats.min << "," << stats.avg << "," << stats.p99 << "," << stats.max << "\n";
+    }
+    std::cout << "Written GPU timings to: " << path << std::endl;
+}
+
+void GpuProfiler::destroy()
+{
+    frames.clear();
+    enabled = false;
+}
+
+void GpuProfiler::collect(FrameQueries &queries)
+{
+    queries.pending = false;
+    uint32_t query_count = static_cast<uint32_t>(queries.names.size()) * 2;
+    if(query_count == 0){
+        return;
+    }
+
+    // The previous submission of this frame was waited on, so the results are already there and nothing blocks
+    auto [result, timestamps] = queries.pool.getResults<uint64_t>(0, query_count, query_count * sizeof(uint64_t), sizeof(uint64_t),
+                                                                  vk::QueryResultFlagBits::e64);
+    if(result != vk::Result::eSuccess){
+        return;
+    }
+
+    for(uint32_t zone = 0; zone < queries.names.size(); zone++){
+        uint64_t ticks = (timestamps[zone * 2 + 1] - timestamps[zone * 2]) & timestamp_mask;
+        float ms = static_cast<float>(ticks * static_cast<double>(timestamp_period) / 1e6);
+
+        ZoneHistory &history = getHistory(queries.names[zone]);
+        history.samples[history.next] = ms;
+        history.next = (history.next + 1) % WINDOW_SIZE;
+        history.count = std::min(history.count + 1, WINDOW_SIZE);
+        history.last = ms;
+    }
+}
+
+GpuProfiler::ZoneHistory &GpuProfiler::getHistory(const char *name)
+{
+    for(ZoneHistory &history : zones){
+        if(std::strcmp(history.name.c_str(), name) == 0){
+            return history;
+        }
+    }
+
+    ZoneHistory history;
+    history.name = name;
+    history.samples.resize(WINDOW_SIZE, 0.f);
+    zones.push_back(std::move(history));
+    return zones.back();
+}
+
+GpuProfiler::ZoneStats GpuProfiler::computeStats(const ZoneHistory &history)
+{
+    ZoneStats stats;
+    stats.name = history.name;
+    stats.samples = history.count;
+    if(history.count == 0){
+        return stats;
+    }
+
+    std::vector<float> sorted(history.samples.begin(), history.samples.begin() + history.count);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for(float sample : sorted){
+        sum += sample;
+    }
+    stats.min = sorted.front();
+    stats.max = sorted.back();
+    stats.avg = static_cast<float>(sum / sorted.size());
+    stats.p99 = sorted[std::min(static_cast<size_t>(sorted.size() * 0.99), sorted.size() - 1)];
+    return stats;
+}
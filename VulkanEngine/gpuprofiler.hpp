@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+/**
+ * GPU timings of named passes, measured with timestamp queries.
+ * There is one query pool per frame in flight: the queries of a frame are read back the next time its slot is
+ * recorded, after its previous submission was waited on, so reading never stalls. Each zone keeps a rolling window
+ * of samples from which min/avg/p99 are computed.
+ */
+class GpuProfiler{
+public:
+    // Rolling statistics of one zone over the last WINDOW_SIZE frames (ms)
+    struct ZoneStats{
+        std::string name;
+        uint32_t samples = 0;
+        float min = 0.f;
+        float avg = 0.f;
+        float p99 = 0.f;
+        float max = 0.f;
+    };
+
+    static const uint32_t MAX_ZONES = 32; // Per frame
+    static const uint32_t WINDOW_SIZE = 512; // Samples kept per zone
+
+    // Disabled (every call is a no-op) when the graphics queue has no timestamps
+    void create(const vk::raii::PhysicalDevice &physical_device, vk::raii::Device &logical_device, uint32_t graphics_family,
+                uint32_t max_frames_in_flight);
+
+    // Collects the results of the last use of frame and resets its queries. Call first thing in the command buffer,
+    // once the previous submission of frame was waited on
+    void beginFrame(vk::raii::CommandBuffer &command_buffer, uint32_t frame);
+
+    // Writes the start timestamp of a zone and returns its index inside the frame (UINT32_MAX when not recorded).
+    // name must outlive the profiler (a string literal)
+    // Zones can nest but must be outside of rendering blocks with secondary command buffer contents
+    uint32_t beginZone(vk::raii::CommandBuffer &command_buffer, const char *name);
+    void endZone(vk::raii::CommandBuffer &command_buffer, uint32_t zone);
+
+    bool isEnabled() const { return enabled; }
+
+    // Last measured duration of a zone (ms), 0 if never measured
+    float getLast(const std::string &name) const;
+
+    std::vector<ZoneStats> getStats() const;
+
+    // Prints the stats of every zone and a histogram of the frame times
+    void printReport() const;
+
+    // Writes one line per zone: zone,samples,min_ms,avg_ms,p99_ms,max_ms
+    void writeCSV(const std::string &path) const;
+
+    void destroy();
+
+private:
+    struct FrameQueries{
+        vk::raii::QueryPool pool = nullptr;
+        std::vector<const char *> names; // Name of each zone written this frame
+        bool pending = false; // Written and not read back yet
+    };
+
+    struct ZoneHistory{
+        std::string name;
+        std::vector<float> samples; // Ring of WINDOW_SIZE samples
+        uint32_t next = 0;
+        uint32_t count = 0;
+        float last = 0.f;
+    };
+
+    bool enabled = false;
+    float timestamp_period = 1.f; // Nanoseconds per tick
+    uint64_t timestamp_mask = ~0ull; // Valid bits of a timestamp
+    std::vector<FrameQueries> frames;
+    uint32_t current_frame = 0;
+    std::vector<ZoneHistory> zones; // Every zone ever measured, in order of appearance
+
+    void collect(FrameQueries &frame);
+    ZoneHistory &getHistory(const char *name);
+    static ZoneStats computeStats(const ZoneHistory &history);
+};
+
+// Zone covering the commands recorded during its lifetime
+class GpuZone{
+public:
+    GpuZone(GpuProfiler &profiler, vk::raii::CommandBuffer &command_buffer, const char *name)
+        : profiler(profiler), command_buffer(command_buffer), zone(profiler.beginZone(command_buffer, name)) {}
+    ~GpuZone() { profiler.endZone(command_buffer, zone); }
+
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+    GpuProfiler &profiler;
+    vk::raii::CommandBuffer &command_buffer;
+    uint32_t zone;
+};
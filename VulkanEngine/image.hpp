@@ -20,7 +20,7 @@ namespace Image{
     // Helper function to find supported depth formats
     vk::Format findDepthFormat(vk::raii::PhysicalDevice &physical_device);
 
-    // Helper function to transition images from one stage mask to another
+    // Helper function to transition images from one stage mask to another. Covers the first level_count mips and layer_count layers
     void transitionImageLayout(
 	    vk::Image               &image,
 	    vk::ImageLayout         old_layout,
@@ -30,7 +30,9 @@ namespace Image{
 	    vk::PipelineStageFlags2 src_stage_mask,
 	    vk::PipelineStageFlags2 dst_stage_mask,
             vk::ImageAspectFlagBits image_aspect,
-            vk::raii::CommandBuffer &command_buffer
+            vk::raii::CommandBuffer &command_buffer,
+            uint32_t level_count = 1,
+            uint32_t layer_count = 1
         );
 
 
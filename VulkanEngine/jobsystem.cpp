@@ -0,0 +1,161 @@
+#include "jobsystem.hpp"
+#include "cpuprofiler.hpp"
+
+namespace{
+    // Deque index of the current thread when it is a worker of some JobSystem
+    thread_local const JobSystem * current_system = nullptr;
+    thread_local uint32_t current_worker = 0;
+}
+
+void JobSystem::create(uint32_t worker_count)
+{
+    destroy();
+
+    if(worker_count == 0){
+        uint32_t hardware_threads = std::thread::hardware_concurrency();
+        worker_count = hardware_threads > 1 ? hardware_threads - 1 : 0;
+    }
+
+    stopping = false;
+    queues.clear();
+    for(uint32_t i = 0; i < worker_count + 1; i++){
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for(uint32_t i = 0; i < worker_count; i++){
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+
+    std::cout << "Job system: " << worker_count << " workers" << std::endl;
+}
+
+TaskHandle JobSystem::submit(std::function<void()> task)
+{
+    auto pending = std::make_shared<std::atomic<uint32_t>>(1);
+    if(workers.empty()){
+        task();
+        pending -> store(0);
+        return TaskHandle(pending);
+    }
+
+    push(Task{std::move(task), pending});
+    return TaskHandle(pending);
+}
+
+void JobSystem::wait(const TaskHandle &handle)
+{
+    uint32_t queue_index = currentQueue();
+    Task task;
+    while(!handle.isDone()){
+        if(popOrSteal(queue_index, task)){
+            run(task);
+        }
+        else{
+            std::this_thread::yield(); // The last tasks are running on other threads
+        }
+    }
+}
+
+void JobSystem::destroy()
+{
+    if(workers.empty()){
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake_up.notify_all();
+    for(std::thread &worker : workers){
+        worker.join();
+    }
+    workers.clear();
+
+    // Whatever the outside threads queued and never waited on
+    Task task;
+    while(popOrSteal(static_cast<uint32_t>(queues.size() - 1), task)){
+        run(task);
+    }
+}
+
+void JobSystem::push(Task task)
+{
+    // Counted before it is visible, so the count never drops below the number of queued tasks
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        queued_tasks++;
+    }
+
+    WorkerQueue &queue = *queues[currentQueue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    wake_up.notify_one();
+}
+
+bool JobSystem::popOrSteal(uint32_t queue_index, Task &task)
+{
+    if(queued_tasks.load(std::memory_order_acquire) == 0){
+        return false;
+    }
+
+    // Own deque first, newest task
+    {
+        WorkerQueue &queue = *queues[queue_index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.tasks.empty()){
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            queued_tasks--;
+            return true;
+        }
+    }
+
+    // Then the oldest task of the others, starting from the next deque so thieves spread out
+    for(uint32_t offset = 1; offset < queues.size(); offset++){
+        WorkerQueue &queue = *queues[(queue_index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(!queue.tasks.empty()){
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            queued_tasks--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::run(Task &task)
+{
+    PROFILE_ZONE("job");
+    task.function();
+    task.pending -> fetch_sub(1, std::memory_order_release);
+    task = Task();
+}
+
+void JobSystem::workerLoop(uint32_t worker_index)
+{
+    current_system = this;
+    current_worker = worker_index;
+    Profiler::setThreadName("worker " + std::to_string(worker_index));
+
+    Task task;
+    while(true){
+        if(popOrSteal(worker_index, task)){
+            run(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake_up.wait(lock, [this](){ return stopping || queued_tasks > 0; });
+        if(stopping && queued_tasks == 0){
+            return;
+        }
+    }
+}
+
+uint32_t JobSystem::currentQueue() const
+{
+    return current_system == this ? current_worker : static_cast<uint32_t>(queues.size() - 1);
+}
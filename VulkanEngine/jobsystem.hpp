@@ -0,0 +1,104 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+// Completion state of one task or a group of tasks
+class TaskHandle{
+public:
+    TaskHandle() = default;
+
+    // True once every task of the handle has run. An empty handle is always done
+    bool isDone() const { return !pending || pending -> load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    explicit TaskHandle(std::shared_ptr<std::atomic<uint32_t>> pending) : pending(std::move(pending)) {}
+
+    std::shared_ptr<std::atomic<uint32_t>> pending; // Tasks still to run
+};
+
+/**
+ * Work-stealing thread pool owned by the engine.
+ * Every worker has its own deque: it pushes and pops at the back, so it keeps working on the freshest (cache-hot)
+ * tasks, while idle workers steal the oldest tasks from the front of the others. Threads outside the pool
+ * (the render thread) share one extra deque. A thread waiting on a handle runs tasks meanwhile instead of blocking,
+ * so tasks can wait on tasks they spawned.
+ */
+class JobSystem{
+public:
+    JobSystem() = default;
+    ~JobSystem() { destroy(); }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Starts worker_count workers. 0 picks one per hardware thread, minus the calling thread
+    void create(uint32_t worker_count = 0);
+
+    // Queues a task on the deque of the calling thread
+    TaskHandle submit(std::function<void()> task);
+
+    // Runs tasks until the handle is done
+    void wait(const TaskHandle &handle);
+
+    /**
+     * Calls func(begin, end) over [0, count) split in ranges of at most grain elements, and returns once all have run.
+     * The calling thread takes part. Ranges are disjoint, so each call can write its own slice of an output array
+     */
+    template<typename Func>
+    void parallel_for(uint32_t count, uint32_t grain, Func &&func){
+        if(count == 0){
+            return;
+        }
+        grain = std::max(grain, 1u);
+        if(workers.empty() || count <= grain){
+            func(0u, count);
+            return;
+        }
+
+        uint32_t range_count = (count + grain - 1) / grain;
+        auto pending = std::make_shared<std::atomic<uint32_t>>(range_count);
+        for(uint32_t begin = 0; begin < count; begin += grain){
+            uint32_t end = std::min(begin + grain, count);
+            push(Task{[&func, begin, end](){ func(begin, end); }, pending});
+        }
+        wait(TaskHandle(pending));
+    }
+
+    // Workers plus the calling thread
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+    // Stops and joins the workers. Queued tasks are run first
+    void destroy();
+
+private:
+    struct Task{
+        std::function<void()> function;
+        std::shared_ptr<std::atomic<uint32_t>> pending;
+    };
+
+    struct WorkerQueue{
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues; // One per worker, the last one is shared by outside threads
+    std::atomic<uint32_t> queued_tasks{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleep_mutex;
+    std::condition_variable wake_up;
+
+    void push(Task task);
+    // Pops from the deque of queue_index or steals from the others. Returns false when every deque is empty
+    bool popOrSteal(uint32_t queue_index, Task &task);
+    void run(Task &task);
+    void workerLoop(uint32_t worker_index);
+    uint32_t currentQueue() const;
+};
@@ -0,0 +1,346 @@
+#include "meshregistry.hpp"
+
+// --- BUILT-IN SHAPES ---
+
+MeshData Meshes::cube(glm::vec3 color)
+{
+    MeshData data;
+    data.vertices = {
+        // FRONT FACE (Normal 0, 0, 1)
+        {glm::vec3(-0.5, 0.5, 0.5), glm::vec3(0, 0, 1), color}, // TL
+        {glm::vec3(0.5, 0.5, 0.5),  glm::vec3(0, 0, 1), color}, // TR
+        {glm::vec3(0.5, -0.5, 0.5), glm::vec3(0, 0, 1), color}, // BR
+        {glm::vec3(-0.5, -0.5, 0.5),glm::vec3(0, 0, 1), color}, // BL
+
+        // BACK FACE (Normal 0, 0, -1)
+        {glm::vec3(0.5, 0.5, -0.5),  glm::vec3(0, 0, -1), color}, // TL
+        {glm::vec3(-0.5, 0.5, -0.5), glm::vec3(0, 0, -1), color}, // TR
+        {glm::vec3(-0.5, -0.5, -0.5),glm::vec3(0, 0, -1), color}, // BR
+        {glm::vec3(0.5, -0.5, -0.5), glm::vec3(0, 0, -1), color}, // BL
+
+        // RIGHT FACE (Normal 1, 0, 0)
+        {glm::vec3(0.5, 0.5, 0.5),  glm::vec3(1, 0, 0), color}, // TL
+        {glm::vec3(0.5, 0.5, -0.5), glm::vec3(1, 0, 0), color}, // TR
+        {glm::vec3(0.5, -0.5, -0.5),glm::vec3(1, 0, 0), color}, // BR
+        {glm::vec3(0.5, -0.5, 0.5), glm::vec3(1, 0, 0), color}, // BL
+
+        // LEFT FACE (Normal -1, 0, 0)
+        {glm::vec3(-0.5, 0.5, -0.5), glm::vec3(-1, 0, 0), color}, // TL
+        {glm::vec3(-0.5, 0.5, 0.5),  glm::vec3(-1, 0, 0), color}, // TR
+        {glm::vec3(-0.5, -0.5, 0.5), glm::vec3(-1, 0, 0), color}, // BR
+        {glm::vec3(-0.5, -0.5, -0.5),glm::vec3(-1, 0, 0), color}, // BL
+
+        // TOP FACE (Normal 0, 1, 0)
+        {glm::vec3(-0.5, 0.5, -0.5), glm::vec3(0, 1, 0), color}, // TL
+        {glm::vec3(0.5, 0.5, -0.5),  glm::vec3(0, 1, 0), color}, // TR
+        {glm::vec3(0.5, 0.5, 0.5),   glm::vec3(0, 1, 0), color}, // BR
+        {glm::vec3(-0.5, 0.5, 0.5),  glm::vec3(0, 1, 0), color}, // BL
+
+        // BOTTOM FACE (Normal 0, -1, 0)
+        {glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0, -1, 0), color}, // TL
+        {glm::vec3(0.5, -0.5, 0.5),  glm::vec3(0, -1, 0), color}, // TR
+        {glm::vec3(0.5, -0.5, -0.5), glm::vec3(0, -1, 0), color}, // BR
+        {glm::vec3(-0.5, -0.5, -0.5),glm::vec3(0, -1, 0), color}, // BL
+    };
+
+    data.indices = {
+        // Front
+        0, 1, 2,  0, 2, 3,
+        // Back
+        4, 5, 6,  4, 6, 7,
+        // Right
+        8, 9, 10, 8, 10, 11,
+        // Left
+        12, 13, 14, 12, 14, 15,
+        // Top
+        16, 17, 18, 16, 18, 19,
+        // Bottom
+        20, 21, 22, 20, 22, 23
+    };
+
+    return data;
+}
+
+MeshData Meshes::plane(float base, float height, glm::vec3 color)
+{
+    float half_base = base / 2.0;
+    float half_height = height / 2.0;
+
+    MeshData data;
+    data.vertices = {
+        {glm::vec3(-half_base, half_height, 0), glm::vec3(0, 0, 1), color},
+        {glm::vec3(half_base, half_height, 0),  glm::vec3(0, 0, 1), color}, 
+        {glm::vec3(half_base, -half_height, 0), glm::vec3(0, 0, 1), color}, 
+        {glm::vec3(-half_base, -half_height, 0),glm::vec3(0, 0, 1), color}
+    };
+
+    data.indices = {
+        0, 1, 2,
+        0, 2, 3
+    };
+
+    return data;
+}
+
+// --- HANDLE ---
+
+MeshHandle::~MeshHandle()
+{
+    if(registry){
+        registry -> removeReference(id);
+    }
+}
+
+MeshHandle::MeshHandle(const MeshHandle &other) : registry(other.registry), id(other.id)
+{
+    if(registry){
+        registry -> addReference(id);
+    }
+}
+
+MeshHandle& MeshHandle::operator=(const MeshHandle &other)
+{
+    if(this != &other){
+        if(other.registry){
+            other.registry -> addReference(other.id);
+        }
+        if(registry){
+            registry -> removeReference(id);
+        }
+        registry = other.registry;
+        id = other.id;
+    }
+    return *this;
+}
+
+MeshHandle::MeshHandle(MeshHandle &&other) noexcept : registry(other.registry), id(other.id)
+{
+    other.registry = nullptr;
+}
+
+MeshHandle& MeshHandle::operator=(MeshHandle &&other) noexcept
+{
+    if(this != &other){
+        if(registry){
+            registry -> removeReference(id);
+        }
+        registry = other.registry;
+        id = other.id;
+        other.registry = nullptr;
+    }
+    return *this;
+}
+
+const MeshRange& MeshHandle::getRange() const
+{
+    return registry -> entries[id].range;
+}
+
+const glm::vec4& MeshHandle::getLocalSphere() const
+{
+    return registry -> entries[id].local_sphere;
+}
+
+const glm::vec3& MeshHandle::getLocalMin() const
+{
+    return registry -> entries[id].local_min;
+}
+
+const glm::vec3& MeshHandle::getLocalMax() const
+{
+    return registry -> entries[id].local_max;
+}
+
+UploadTicket MeshHandle::getUploadTicket() const
+{
+    return registry -> entries[id].upload_ticket;
+}
+
+const MeshData& MeshHandle::getData() const
+{
+    return registry -> entries[id].data;
+}
+
+// --- REGISTRY ---
+
+void MeshRegistry::create(GeometryBuffer &geometry, UploadQueue &upload_queue, int max_frames_in_flight)
+{
+    this -> geometry = &geometry;
+    this -> upload_queue = &upload_queue;
+    this -> max_frames_in_flight = max_frames_in_flight;
+}
+
+MeshHandle MeshRegistry::load(MeshData data, bool keep_cpu_data)
+{
+    if(!geometry){
+        throw std::runtime_error("Mesh registry used before being created!");
+    }
+
+    // The bytes are compared while the entry keeps its CPU data. Once it is gone, sizes and both 64-bit hashes must match
+    uint64_t hash = hashMesh(data);
+    uint64_t check_hash = checkHashMesh(data);
+    auto [first, last] = hash_to_id.equal_range(hash);
+    for(auto it = first; it != last; it++){
+        MeshEntry &entry = entries[it -> second];
+        if(entry.range.vertex_count != data.vertices.size() || entry.range.index_count != data.indices.size()){
+            continue;
+        }
+        if(!entry.data.vertices.empty()){
+            if(entry.data.vertices != data.vertices || entry.data.indices != data.indices){
+                continue;
+            }
+        }
+        else if(entry.check_hash != check_hash){
+            continue;
+        }
+
+        if(keep_cpu_data && entry.data.vertices.empty()){
+            entry.data = std::move(data);
+        }
+        addReference(it -> second);
+        return MeshHandle(this, it -> second);
+    }
+
+    uint32_t id;
+    if(!free_ids.empty()){
+        id = free_ids.back();
+        free_ids.pop_back();
+    }
+    else{
+        id = static_cast<uint32_t>(entries.size());
+        entries.emplace_back();
+    }
+
+    MeshEntry &entry = entries[id];
+    entry = MeshEntry();
+    entry.hash = hash;
+    entry.check_hash = check_hash;
+    entry.alive = true;
+    entry.data = std::move(data);
+    computeBounds(entry);
+
+    // The upload queue copies the data right away, so the CPU copy is not needed after this
+    entry.range = geometry -> allocate(entry.data.vertices, entry.data.indices, *upload_queue, &entry.upload_ticket);
+    if(!keep_cpu_data){
+        entry.data = MeshData();
+    }
+
+    hash_to_id.emplace(hash, id);
+    addReference(id);
+    return MeshHandle(this, id);
+}
+
+void MeshRegistry::endFrame()
+{
+    frame++;
+
+    // A mesh released in frame f can still be drawn by the frames in flight up to f
+    for(size_t i = 0; i < retired_ids.size();){
+        MeshEntry &entry = entries[retired_ids[i]];
+        if(entry.references == 0 && frame - entry.release_frame > (uint64_t)max_frames_in_flight){
+            freeEntry(retired_ids[i]);
+            retired_ids[i] = retired_ids.back();
+            retired_ids.pop_back();
+        }
+        else{
+            i++;
+        }
+    }
+}
+
+void MeshRegistry::destroy()
+{
+    for(uint32_t id = 0; id < entries.size(); id++){
+        if(entries[id].alive){
+            freeEntry(id);
+        }
+    }
+    retired_ids.clear();
+    geometry = nullptr;
+    upload_queue = nullptr;
+}
+
+void MeshRegistry::addReference(uint32_t id)
+{
+    MeshEntry &entry = entries[id];
+    if(entry.references == 0 && entry.release_frame != 0){
+        // Revived before being freed
+        std::erase(retired_ids, id);
+        entry.release_frame = 0;
+    }
+    entry.references++;
+}
+
+void MeshRegistry::removeReference(uint32_t id)
+{
+    MeshEntry &entry = entries[id];
+    if(!entry.alive){
+        return; // Registry already destroyed
+    }
+
+    entry.references--;
+    if(entry.references == 0){
+        entry.release_frame = frame + 1; // Never 0, which marks a mesh that was not released
+        retired_ids.push_back(id);
+    }
+}
+
+void MeshRegistry::freeEntry(uint32_t id)
+{
+    MeshEntry &entry = entries[id];
+
+    auto [first, last] = hash_to_id.equal_range(entry.hash);
+    for(auto it = first; it != last; it++){
+        if(it -> second == id){
+            hash_to_id.erase(it);
+            break;
+        }
+    }
+
+    if(geometry){
+        geometry -> free(entry.range);
+    }
+    entry = MeshEntry();
+    free_ids.push_back(id);
+}
+
+uint64_t MeshRegistry::hashMesh(const MeshData &data)
+{
+    std::string_view vertex_bytes(reinterpret_cast<const char *>(data.vertices.data()), sizeof(Vertex) * data.vertices.size());
+    std::string_view index_bytes(reinterpret_cast<const char *>(data.indices.data()), sizeof(uint32_t) * data.indices.size());
+
+    uint64_t hash = std::hash<std::string_view>{}(vertex_bytes);
+    hash ^= std::hash<std::string_view>{}(index_bytes) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+uint64_t MeshRegistry::checkHashMesh(const MeshData &data)
+{
+    uint64_t hash = hashFNV1a(data.vertices.data(), sizeof(Vertex) * data.vertices.size());
+    return hashFNV1a(data.indices.data(), sizeof(uint32_t) * data.indices.size(), hash);
+}
+
+void MeshRegistry::computeBounds(MeshEntry &entry)
+{
+    const std::vector<Vertex> &vertices = entry.data.vertices;
+    if(vertices.empty()){
+        return;
+    }
+
+    glm::vec3 min_corner = vertices[0].position;
+    glm::vec3 max_corner = vertices[0].position;
+    for(const Vertex &vertex : vertices){
+        min_corner = glm::min(min_corner, vertex.position);
+        max_corner = glm::max(max_corner, vertex.position);
+    }
+
+    // The sphere is centered on the box
+    glm::vec3 center = (min_corner + max_corner) * 0.5f;
+    float radius = 0.f;
+    for(const Vertex &vertex : vertices){
+        radius = std::max(radius, glm::length(vertex.position - center));
+    }
+    entry.local_sphere = glm::vec4(center, radius);
+    entry.local_min = min_corner;
+    entry.local_max = max_corner;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include <unordered_map>
+#include <string_view>
+
+#include "geometrybuffer.hpp"
+#include "uploadqueue.hpp"
+
+// CPU side geometry of a mesh
+struct MeshData{
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+// Built-in shapes
+namespace Meshes{
+    // Unit cube centered on the origin, one normal per face
+    MeshData cube(glm::vec3 color = glm::vec3(0.5f));
+
+    // Quad on the XY plane centered on the origin, facing +Z
+    MeshData plane(float base, float height, glm::vec3 color = glm::vec3(0.5f));
+}
+
+class MeshRegistry;
+
+// Reference counted handle to a mesh of the MeshRegistry. The mesh is released when the last handle goes away
+class MeshHandle{
+public:
+    MeshHandle() = default;
+    ~MeshHandle();
+
+    MeshHandle(const MeshHandle &other);
+    MeshHandle& operator=(const MeshHandle &other);
+    MeshHandle(MeshHandle &&other) noexcept;
+    MeshHandle& operator=(MeshHandle &&other) noexcept;
+
+    bool isValid() const { return registry != nullptr; }
+
+    // Draw parameters inside the GeometryBuffer
+    const MeshRange& getRange() const;
+
+    // Local bounds: sphere (center xyz, radius w) and box
+    const glm::vec4& getLocalSphere() const;
+    const glm::vec3& getLocalMin() const;
+    const glm::vec3& getLocalMax() const;
+
+    // Completes when the geometry is on the GPU
+    UploadTicket getUploadTicket() const;
+
+    // CPU copy of the geometry. Empty unless the mesh was loaded with keep_cpu_data
+    const MeshData& getData() const;
+
+private:
+    friend class MeshRegistry;
+    MeshHandle(MeshRegistry *registry, uint32_t id) : registry(registry), id(id) {}
+
+    MeshRegistry * registry = nullptr;
+    uint32_t id = 0;
+};
+
+/**
+ * Owner of the meshes in the GeometryBuffer.
+ * Meshes are deduplicated by their content, so loading the same geometry again returns a handle to
+ * the mesh already on the GPU. Once uploaded, the CPU copy is dropped unless asked otherwise.
+ * Meshes with no handles left are freed max_frames_in_flight frames later, when no frame can still draw them.
+ */
+class MeshRegistry{
+public:
+    void create(GeometryBuffer &geometry, UploadQueue &upload_queue, int max_frames_in_flight);
+
+    // Returns a handle to the mesh, uploading it only if it is not loaded yet
+    MeshHandle load(MeshData data, bool keep_cpu_data = false);
+
+    // Frees the meshes released long enough ago. To be called once per frame
+    void endFrame();
+
+    // Number of meshes alive on the GPU
+    uint32_t getMeshCount() const { return static_cast<uint32_t>(hash_to_id.size()); }
+
+    // Frees every mesh. Handles still alive become no-ops
+    void destroy();
+
+private:
+    friend class MeshHandle;
+
+    struct MeshEntry{
+        MeshRange range;
+        MeshData data;
+        glm::vec4 local_sphere = glm::vec4(0.f);
+        glm::vec3 local_min = glm::vec3(0.f);
+        glm::vec3 local_max = glm::vec3(0.f);
+        UploadTicket upload_ticket;
+        uint64_t hash = 0;
+        uint64_t check_hash = 0; // Computed another way, together with hash it stands in for the bytes once the CPU data is gone
+        uint32_t references = 0;
+        uint64_t release_frame = 0; // Frame the last handle went away
+        bool alive = false;
+    };
+
+    GeometryBuffer * geometry = nullptr;
+    UploadQueue * upload_queue = nullptr;
+    int max_frames_in_flight = 2;
+
+    std::vector<MeshEntry> entries; // Indexed by handle id
+    std::vector<uint32_t> free_ids;
+    std::unordered_multimap<uint64_t, uint32_t> hash_to_id;
+    std::vector<uint32_t> retired_ids; // Meshes with no handles, waiting for the GPU to be done with them
+    uint64_t frame = 0;
+
+    void addReference(uint32_t id);
+    void removeReference(uint32_t id);
+    void freeEntry(uint32_t id);
+
+    // Helper functions for deduplication
+    static uint64_t hashMesh(const MeshData &data);
+    static uint64_t checkHashMesh(const MeshData &data); // hashFNV1a, independent of hashMesh
+    static void computeBounds(MeshEntry &entry);
+};
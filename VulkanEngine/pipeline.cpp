@@ -1,20 +1,20 @@
 #include "pipeline.hpp"
+#include "cpuprofiler.hpp"
 
 void PipelineBuilder::set_name(std::string name)
 {
     pipeline_bundle.name = std::move(name);
 }
 
-void PipelineBuilder::add_shader(std::string path, vk::ShaderStageFlagBits stage, vk::raii::Device &logical_device)
+void PipelineBuilder::add_shader(std::string path, vk::ShaderStageFlagBits stage, const ShaderSpecialization &specialization)
 {
-    pipeline_bundle.shaders.push_back(createShaderModule(readFile(path), logical_device));
-
-    vk::PipelineShaderStageCreateInfo shader_info;
-    shader_info.stage = stage;
-    shader_info.module = *pipeline_bundle.shaders[pipeline_bundle.shaders.size() - 1];
-    shader_info.pName = "main";
+    pipeline_bundle.shader_stages.push_back(createShaderStage(path, stage, specialization));
+}
 
-    pipeline_bundle.shader_stages.push_back(shader_info);
+void PipelineBuilder::add_shader_variant(std::string source_path, vk::ShaderStageFlagBits stage, const std::vector<std::string> &defines,
+                                         const ShaderSpecialization &specialization)
+{
+    pipeline_bundle.shader_stages.push_back(createShaderStage(source_path, stage, specialization, &defines));
 }
 
 void PipelineBuilder::set_topology(vk::PrimitiveTopology topology)
@@ -79,94 +79,141 @@ void PipelineBuilder::set_push_constant(vk::ShaderStageFlagBits stage, uint32_t
     pipeline_bundle.push_constant_ranges.push_back(constant_range);
 }
 
+void PipelineBuilder::set_pipeline_cache(const vk::raii::PipelineCache *pipeline_cache)
+{
+    this -> pipeline_cache = pipeline_cache;
+}
+
+void PipelineBuilder::set_shader_library(ShaderLibrary *shader_library)
+{
+    this -> shader_library = shader_library;
+}
+
+void PipelineBuilder::set_descriptor_heap(const DescriptorHeap *descriptor_heap)
+{
+    this -> descriptor_heap = descriptor_heap;
+}
+
 RasterPipelineBundle PipelineBuilder::build(std::vector<vk::DescriptorSetLayoutBinding> *bindings, vk::raii::Device &logical_device)
 {
-    pipeline_bundle.descriptor_set_layout = createDescriptorSetLayout(*bindings, logical_device);
+    PROFILE_ZONE("build pipeline");
+    createLayouts(bindings, logical_device);
 
+    auto creation_start = std::chrono::high_resolution_clock::now();
+    pipeline_bundle.pipeline = get_graphics_state(pipeline_bundle.layout).create(logical_device, pipeline_cache);
+    creation_ms += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - creation_start).count();
 
-    // Vertex components
-    vk::VertexInputBindingDescription binding_description = Vertex::getBindingDescription();
-    auto attribute_descriptions = Vertex::getAttributeDescriptions(); // Here auto since probably the array will change in future, it is just safer
+    std::cout << "Created Pipeline:\n" << pipeline_bundle.to_str() << std::endl;
+
+
+    return std::move(pipeline_bundle);
+}
+
+RasterPipelineBundle PipelineBuilder::build_async(std::vector<vk::DescriptorSetLayoutBinding> *bindings, vk::raii::Device &logical_device,
+                                                  PipelineCompiler &compiler, PipelineTicket &ticket)
+{
+    createLayouts(bindings, logical_device);
+    ticket = compiler.submit(get_graphics_state(pipeline_bundle.layout));
 
-    vk::PipelineVertexInputStateCreateInfo vertex_input_info;
-    vertex_input_info.vertexBindingDescriptionCount = 1;
-    vertex_input_info.pVertexBindingDescriptions = &binding_description; 
-    vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size()); // Good practice to cast
-    vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data(); 
+    std::cout << "Queued Pipeline:\n" << pipeline_bundle.to_str() << std::endl;
+
+    return std::move(pipeline_bundle);
+}
+
+PipelineTicket PipelineBuilder::rebuild_async(vk::PipelineLayout layout, PipelineCompiler &compiler)
+{
+    PipelineTicket ticket = compiler.submit(get_graphics_state(layout));
+    pipeline_bundle = RasterPipelineBundle(); // Nothing is moved out, so start over explicitly
+    return ticket;
+}
+
+GraphicsPipelineState PipelineBuilder::get_graphics_state(vk::PipelineLayout layout) const
+{
+    GraphicsPipelineState state;
+    state.name = pipeline_bundle.name;
+    state.shader_stages = pipeline_bundle.shader_stages;
+    state.input_assembly = pipeline_bundle.input_assembly;
+    state.rasterizer = pipeline_bundle.rasterizer;
+    state.multisampling = pipeline_bundle.multisampling;
+    state.color_blend_attachments = pipeline_bundle.color_blend_attachments;
+    state.color_formats = pipeline_bundle.color_formats;
+    state.depth_format = pipeline_bundle.pipeline_rendering_create_info.depthAttachmentFormat;
+    state.depth_stencil = pipeline_bundle.depth_stencil;
+    state.layout = layout;
+    return state;
+}
+
+void PipelineBuilder::createLayouts(std::vector<vk::DescriptorSetLayoutBinding> *bindings, vk::raii::Device &logical_device)
+{
+    // The heap comes first, so every raster pipeline sees it as set 0 and it stays bound across pipeline changes
+    std::vector<vk::DescriptorSetLayout> set_layouts;
+    if(descriptor_heap){
+        set_layouts.push_back(descriptor_heap -> getLayout());
+    }
+    if(bindings && !bindings -> empty()){
+        pipeline_bundle.descriptor_set_layout = createDescriptorSetLayout(*bindings, logical_device);
+        set_layouts.push_back(*pipeline_bundle.descriptor_set_layout);
+    }
 
     // Layout create info
     vk::PipelineLayoutCreateInfo pipeline_layout_info;
-    pipeline_layout_info.setLayoutCount = 1;
-    pipeline_layout_info.pSetLayouts = &*(pipeline_bundle.descriptor_set_layout);  
+    pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+    pipeline_layout_info.pSetLayouts = set_layouts.data();
     if(pipeline_bundle.push_constant_ranges.size() > 0){
         pipeline_layout_info.pushConstantRangeCount = static_cast<uint32_t>(pipeline_bundle.push_constant_ranges.size());
         pipeline_layout_info.pPushConstantRanges = pipeline_bundle.push_constant_ranges.data();
     }  
     pipeline_bundle.layout = vk::raii::PipelineLayout(logical_device, pipeline_layout_info);
+}
+
+ComputePipelineBundle PipelineBuilder::build_compute(std::string path, std::vector<vk::DescriptorSetLayoutBinding> *bindings, vk::raii::Device &logical_device,
+                                                     const ShaderSpecialization &specialization)
+{
+    PROFILE_ZONE("build compute pipeline");
+    ComputePipelineBundle compute_bundle;
+    compute_bundle.name = pipeline_bundle.name;
+    compute_bundle.push_constant_ranges = std::move(pipeline_bundle.push_constant_ranges);
+    pipeline_bundle.push_constant_ranges.clear();
 
-    // Dynamic states
-    std::vector dynamic_states = {
-        vk::DynamicState::eViewport,
-        vk::DynamicState::eScissor,
-        vk::DynamicState::eCullMode
-    };
-    vk::PipelineDynamicStateCreateInfo dynamic_state;
-    dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
-    dynamic_state.pDynamicStates = dynamic_states.data();
-
-    // Viewport information
-    vk::PipelineViewportStateCreateInfo viewport_state;
-    viewport_state.viewportCount = 1;
-    viewport_state.scissorCount = 1;
-
-    // Finalizing color attachments
-    pipeline_bundle.color_blending.logicOpEnable = vk::False;
-    pipeline_bundle.color_blending.attachmentCount = pipeline_bundle.color_blend_attachments.size();
-    pipeline_bundle.color_blending.pAttachments = pipeline_bundle.color_blend_attachments.data();
-
-    vk::GraphicsPipelineCreateInfo pipeline_info;
-    pipeline_info.pNext = &pipeline_bundle.pipeline_rendering_create_info;
-    pipeline_info.stageCount = pipeline_bundle.shader_stages.size();
-    pipeline_info.pStages = pipeline_bundle.shader_stages.data();
-    pipeline_info.pVertexInputState = &vertex_input_info;
-    pipeline_info.pInputAssemblyState = &pipeline_bundle.input_assembly;
-    pipeline_info.pViewportState = &viewport_state;
-    pipeline_info.pRasterizationState = &pipeline_bundle.rasterizer;
-    pipeline_info.pColorBlendState = &pipeline_bundle.color_blending;
-    pipeline_info.pDynamicState = &dynamic_state;
-    pipeline_info.layout = pipeline_bundle.layout;
-    pipeline_info.pDepthStencilState = &pipeline_bundle.depth_stencil;
-    pipeline_info.pMultisampleState = &pipeline_bundle.multisampling;
-
-    pipeline_bundle.pipeline = vk::raii::Pipeline(logical_device, nullptr, pipeline_info);
+    compute_bundle.descriptor_set_layout = createDescriptorSetLayout(*bindings, logical_device);
 
-    std::cout << "Created Pipeline:\n" << pipeline_bundle.to_str() << std::endl;
+    // Layout create info
+    vk::PipelineLayoutCreateInfo pipeline_layout_info;
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &*(compute_bundle.descriptor_set_layout);
+    if(compute_bundle.push_constant_ranges.size() > 0){
+        pipeline_layout_info.pushConstantRangeCount = static_cast<uint32_t>(compute_bundle.push_constant_ranges.size());
+        pipeline_layout_info.pPushConstantRanges = compute_bundle.push_constant_ranges.data();
+    }
+    compute_bundle.layout = vk::raii::PipelineLayout(logical_device, pipeline_layout_info);
 
+    vk::ComputePipelineCreateInfo pipeline_info;
+    pipeline_info.stage = createShaderStage(path, vk::ShaderStageFlagBits::eCompute, specialization);
+    pipeline_info.layout = compute_bundle.layout;
 
-    return std::move(pipeline_bundle);
-}
+    auto creation_start = std::chrono::high_resolution_clock::now();
+    compute_bundle.pipeline = vk::raii::Pipeline(logical_device, pipeline_cache, pipeline_info);
+    creation_ms += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - creation_start).count();
 
-vk::raii::ShaderModule PipelineBuilder::createShaderModule(const std::vector<char> &code, const vk::raii::Device &logical_device)
-{
-    vk::ShaderModuleCreateInfo create_info;
-    create_info.codeSize = code.size();
-    create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    std::cout << "Created Compute Pipeline:\nName:" << compute_bundle.name << "\n" << std::endl;
 
-    vk::raii::ShaderModule shader_module{logical_device, create_info};
-    return std::move(shader_module);
+    return std::move(compute_bundle);
 }
 
-std::vector<char> PipelineBuilder::readFile(const std::string& filename){
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
-    if(!file.is_open()){
-        throw std::runtime_error("failed to open file: " + filename);
+vk::PipelineShaderStageCreateInfo PipelineBuilder::createShaderStage(const std::string &path, vk::ShaderStageFlagBits stage, const ShaderSpecialization &specialization,
+                                                                     const std::vector<std::string> *defines)
+{
+    if(!shader_library){
+        throw std::runtime_error("PipelineBuilder has no shader library!");
     }
-    size_t file_size = (size_t) file.tellg();
-    std::vector<char> buffer(file_size);
-    file.seekg(0);
-    file.read(buffer.data(), file_size);
-    file.close();
-    return buffer;
+
+    // Modules and specialization infos are owned by the library, so they outlive the stage info
+    vk::PipelineShaderStageCreateInfo shader_info;
+    shader_info.stage = stage;
+    shader_info.module = defines ? shader_library -> loadVariant(path, *defines) : shader_library -> load(path);
+    shader_info.pName = "main";
+    shader_info.pSpecializationInfo = shader_library -> getSpecializationInfo(specialization);
+    return shader_info;
 }
 
 
@@ -183,6 +230,8 @@ vk::raii::DescriptorPool PipelineBuilder::createDescriptorPool(std::vector<vk::D
 
     int total_uniform_buffers = 0;
     int total_ssbo = 0;
+    int total_dynamic_uniform_buffers = 0;
+    int total_dynamic_ssbo = 0;
     for(size_t i = 0; i < bindings.size(); i++){
         if(bindings[i].descriptorType == vk::DescriptorType::eUniformBuffer){
             total_uniform_buffers += bindings[i].descriptorCount;
@@ -190,13 +239,25 @@ vk::raii::DescriptorPool PipelineBuilder::createDescriptorPool(std::vector<vk::D
         else if(bindings[i].descriptorType == vk::DescriptorType::eStorageBuffer){
             total_ssbo += bindings[i].descriptorCount;
         }
+        else if(bindings[i].descriptorType == vk::DescriptorType::eUniformBufferDynamic){
+            total_dynamic_uniform_buffers += bindings[i].descriptorCount;
+        }
+        else if(bindings[i].descriptorType == vk::DescriptorType::eStorageBufferDynamic){
+            total_dynamic_ssbo += bindings[i].descriptorCount;
+        }
     }
 
     if(total_uniform_buffers > 0){
-        pool_sizes.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, total_uniform_buffers));
+        pool_sizes.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eUniformBuffer, total_uniform_buffers * max_frames_in_flight));
     }
     if(total_ssbo > 0){
-        pool_sizes.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, total_ssbo));
+        pool_sizes.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, total_ssbo * max_frames_in_flight));
+    }
+    if(total_dynamic_uniform_buffers > 0){
+        pool_sizes.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eUniformBufferDynamic, total_dynamic_uniform_buffers * max_frames_in_flight));
+    }
+    if(total_dynamic_ssbo > 0){
+        pool_sizes.push_back(vk::DescriptorPoolSize(vk::DescriptorType::eStorageBufferDynamic, total_dynamic_ssbo * max_frames_in_flight));
     }
 
     vk::DescriptorPoolCreateInfo pool_info;
@@ -270,6 +331,16 @@ void PipelineBuilder::writeDescriptorSets(
                     });
                 }
             }
+            else if (bindings[j].descriptorType == vk::DescriptorType::eUniformBufferDynamic || bindings[j].descriptorType == vk::DescriptorType::eStorageBufferDynamic) {
+                // Dynamic buffers are shared by all frames: the resource is the range itself, the frame slice is picked by the dynamic offset at bind time
+                auto* info = static_cast<vk::DescriptorBufferInfo*>(resources[j]);
+
+                writes.push_back(vk::WriteDescriptorSet{
+                    *descriptor_sets[i], bindings[j].binding, 0,
+                    1, bindings[j].descriptorType,
+                    nullptr, info, nullptr
+                });
+            }
         }
 
         if (!writes.empty()) {
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "../Helpers/GeneralLibraries.hpp"
+#include "shaderlibrary.hpp"
+#include "pipelinecompiler.hpp"
+#include "descriptorheap.hpp"
 
 /**
  * This is a builder class.
@@ -12,7 +15,10 @@ public:
 
     // All the builder functions
     void set_name(std::string name);
-    void add_shader(std::string path, vk::ShaderStageFlagBits stage, vk::raii::Device &logical_device);
+    void add_shader(std::string path, vk::ShaderStageFlagBits stage, const ShaderSpecialization &specialization = {});
+    // GLSL source compiled with defines, see ShaderLibrary::loadVariant
+    void add_shader_variant(std::string source_path, vk::ShaderStageFlagBits stage, const std::vector<std::string> &defines,
+                            const ShaderSpecialization &specialization = {});
     void set_topology(vk::PrimitiveTopology topology);
     void set_rasterizer(vk::CullModeFlags cull_mode, vk::FrontFace front_face, vk::PolygonMode mode);
     void set_multisampling_none();
@@ -20,18 +26,44 @@ public:
     void set_color_and_depth_format(std::vector<vk::Format> color_formats,vk::Format depth_format);
     void set_depth_stencil(bool depth_test_enable, bool depth_write_enable, vk::CompareOp op);
     void set_push_constant(vk::ShaderStageFlagBits stage, uint32_t offset, uint32_t size);
+    void set_pipeline_cache(const vk::raii::PipelineCache *pipeline_cache); // Used by every following build, nullptr for none
+    void set_shader_library(ShaderLibrary *shader_library); // Source of every shader module, must outlive the builder
+    void set_descriptor_heap(const DescriptorHeap *descriptor_heap); // Set 0 of every following raster build, the bindings go to set 1. nullptr for none
 
+    // bindings can be nullptr when the pipeline only reads the descriptor heap
     RasterPipelineBundle build(std::vector<vk::DescriptorSetLayoutBinding> *bindings, vk::raii::Device &logical_device);
 
+    // Same as build, but the pipeline is left null and created by compiler. ticket delivers it once compiled
+    RasterPipelineBundle build_async(std::vector<vk::DescriptorSetLayoutBinding> *bindings, vk::raii::Device &logical_device,
+                                     PipelineCompiler &compiler, PipelineTicket &ticket);
+
+    // Compiles the configured state against an existing layout (e.g. new shaders for a bundle already in use)
+    PipelineTicket rebuild_async(vk::PipelineLayout layout, PipelineCompiler &compiler);
+
+    // Builds a compute pipeline from a single shader. Uses the name and push constants set on the builder
+    ComputePipelineBundle build_compute(std::string path, std::vector<vk::DescriptorSetLayoutBinding> *bindings, vk::raii::Device &logical_device,
+                                        const ShaderSpecialization &specialization = {});
+
 
     // Helper functions
     static vk::raii::DescriptorSetLayout createDescriptorSetLayout(std::vector<vk::DescriptorSetLayoutBinding> &bindings, const vk::raii::Device &logical_device);
     static vk::raii::DescriptorPool createDescriptorPool(std::vector<vk::DescriptorSetLayoutBinding> &bindings, vk::raii::Device &logical_device, int max_frames_in_flight);
     static std::vector<vk::raii::DescriptorSet> createDescriptorSets(vk::raii::DescriptorSetLayout &descriptor_set_layout, vk::raii::DescriptorPool &descriptor_pool, vk::raii::Device &logical_device, int max_frames_in_flight);
+    // Total time spent inside pipeline creation by this builder (ms)
+    float get_creation_time() const { return creation_ms; }
+
     static void writeDescriptorSets(const std::vector<vk::raii::DescriptorSet> &descriptor_sets, const std::vector<vk::DescriptorSetLayoutBinding> &bindings, const std::vector<void *> &resources, vk::raii::Device &logical_device, const int max_frames_in_flight);
 
 private:
+    const vk::raii::PipelineCache * pipeline_cache = nullptr;
+    ShaderLibrary * shader_library = nullptr;
+    const DescriptorHeap * descriptor_heap = nullptr;
+    float creation_ms = 0.f;
+
     // Helper functions
-    vk::raii::ShaderModule createShaderModule(const std::vector<char> &code, const vk::raii::Device &logical_device);
-    std::vector<char> readFile(const std::string& filename);
+    GraphicsPipelineState get_graphics_state(vk::PipelineLayout layout) const;
+    void createLayouts(std::vector<vk::DescriptorSetLayoutBinding> *bindings, vk::raii::Device &logical_device);
+    // path is SPIR-V, or GLSL source when defines is given
+    vk::PipelineShaderStageCreateInfo createShaderStage(const std::string &path, vk::ShaderStageFlagBits stage, const ShaderSpecialization &specialization,
+                                                        const std::vector<std::string> *defines = nullptr);
 };
\ No newline at end of file
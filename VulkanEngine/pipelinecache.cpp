@@ -0,0 +1,113 @@
+#include "pipelinecache.hpp"
+
+#include <cstring>
+#include <cstdio>
+
+void PipelineCache::create(const std::string &path, const vk::raii::PhysicalDevice &physical_device, vk::raii::Device &logical_device)
+{
+    this -> path = path;
+
+    vk::PhysicalDeviceProperties properties = physical_device.getProperties();
+    device_header.magic = MAGIC;
+    device_header.version = VERSION;
+    device_header.vendor_id = properties.vendorID;
+    device_header.device_id = properties.deviceID;
+    device_header.driver_version = properties.driverVersion;
+    std::memcpy(device_header.cache_uuid, properties.pipelineCacheUUID.data(), VK_UUID_SIZE);
+
+    std::vector<char> data = readValidData(path);
+
+    vk::PipelineCacheCreateInfo cache_info;
+    cache_info.initialDataSize = data.size();
+    cache_info.pInitialData = data.data();
+    try{
+        cache = vk::raii::PipelineCache(logical_device, cache_info);
+        warm = !data.empty();
+    }
+    catch(const vk::SystemError &error){
+        // The driver rejected the blob after all, start over
+        std::cout << "Pipeline cache rejected by the driver (" << error.what() << "), starting empty" << std::endl;
+        cache = vk::raii::PipelineCache(logical_device, vk::PipelineCacheCreateInfo());
+        warm = false;
+    }
+
+    std::cout << "Pipeline cache: " << (warm ? "loaded " + std::to_string(data.size()) + " bytes from " + path : std::string("empty")) << std::endl;
+}
+
+void PipelineCache::save(float creation_ms)
+{
+    if(cache == nullptr){
+        return;
+    }
+
+    std::vector<uint8_t> data = cache.getData();
+
+    FileHeader header = device_header;
+    header.data_size = data.size();
+    header.data_hash = hashFNV1a(data.data(), data.size());
+    header.cold_creation_ms = warm ? cold_creation_ms : creation_ms;
+
+    std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+        if(!file.is_open()){
+            std::cout << "Failed to write pipeline cache: " << temporary_path << std::endl;
+            return;
+        }
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(data.data()), data.size());
+        if(!file){
+            std::cout << "Failed to write pipeline cache: " << temporary_path << std::endl;
+            return;
+        }
+    }
+
+    if(std::rename(temporary_path.c_str(), path.c_str()) != 0){
+        std::cout << "Failed to replace pipeline cache: " << path << std::endl;
+        std::remove(temporary_path.c_str());
+        return;
+    }
+    std::cout << "Saved pipeline cache: " << data.size() << " bytes to " << path << std::endl;
+}
+
+std::vector<char> PipelineCache::readValidData(const std::string &path)
+{
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if(!file.is_open()){
+        return {};
+    }
+
+    size_t file_size = static_cast<size_t>(file.tellg());
+    file.seekg(0);
+
+    FileHeader header;
+    if(file_size < sizeof(FileHeader) || !file.read(reinterpret_cast<char *>(&header), sizeof(header))){
+        std::cout << "Pipeline cache file too small, ignoring it" << std::endl;
+        return {};
+    }
+
+    if(header.magic != MAGIC || header.version != VERSION){
+        std::cout << "Pipeline cache file has an unknown format, ignoring it" << std::endl;
+        return {};
+    }
+    if(header.vendor_id != device_header.vendor_id || header.device_id != device_header.device_id ||
+       header.driver_version != device_header.driver_version ||
+       std::memcmp(header.cache_uuid, device_header.cache_uuid, VK_UUID_SIZE) != 0){
+        std::cout << "Pipeline cache file belongs to another device or driver, ignoring it" << std::endl;
+        return {};
+    }
+    if(header.data_size != file_size - sizeof(FileHeader)){
+        std::cout << "Pipeline cache file is truncated, ignoring it" << std::endl;
+        return {};
+    }
+
+    std::vector<char> data(header.data_size);
+    if(!file.read(data.data(), data.size()) || hashFNV1a(data.data(), data.size()) != header.data_hash){
+        std::cout << "Pipeline cache file is corrupted, ignoring it" << std::endl;
+        return {};
+    }
+
+    cold_creation_ms = header.cold_creation_ms;
+    return data;
+}
+
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+/**
+ * VkPipelineCache persisted on disk between runs.
+ * The file starts with our own header: the device identity (pipelineCacheUUID, vendor ID, device ID and driver
+ * version) plus the size and hash of the driver blob. A file written by another device or driver, truncated or
+ * corrupted is ignored and the cache starts empty, so a bad file only costs a cold start.
+ */
+class PipelineCache{
+public:
+    // Creates the cache, seeded from path when the file is valid for this device
+    void create(const std::string &path, const vk::raii::PhysicalDevice &physical_device, vk::raii::Device &logical_device);
+
+    // Writes the cache back to path. Goes through a temporary file, so a crash never leaves a half-written cache
+    void save(float creation_ms);
+
+    // Cache to pass to pipeline creation
+    const vk::raii::PipelineCache &getCache() const { return cache; }
+
+    // True when the cache was seeded from disk
+    bool isWarm() const { return warm; }
+
+    // Pipeline creation time of the last cold run, 0 if unknown
+    float getColdCreationTime() const { return cold_creation_ms; }
+
+    void destroy() { cache = nullptr; }
+
+private:
+    // Header of the file on disk, followed by data_size bytes of driver data
+    struct FileHeader{
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t vendor_id = 0;
+        uint32_t device_id = 0;
+        uint32_t driver_version = 0;
+        uint8_t cache_uuid[VK_UUID_SIZE] = {};
+        uint64_t data_size = 0;
+        uint64_t data_hash = 0;
+        float cold_creation_ms = 0.f; // Kept across warm runs for the startup report
+    };
+    static const uint32_t MAGIC = 0x50434348; // "PCCH"
+    static const uint32_t VERSION = 1;
+
+    vk::raii::PipelineCache cache = nullptr;
+    std::string path;
+    FileHeader device_header; // Identity of the current device
+    bool warm = false;
+    float cold_creation_ms = 0.f;
+
+    // Returns the driver data of the file, empty when the file is missing or not valid for this device
+    std::vector<char> readValidData(const std::string &path);
+};
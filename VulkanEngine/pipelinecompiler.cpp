@@ -0,0 +1,154 @@
+#include "pipelinecompiler.hpp"
+#include "cpuprofiler.hpp"
+
+// --- GRAPHICS PIPELINE STATE ---
+
+vk::raii::Pipeline GraphicsPipelineState::create(const vk::raii::Device &logical_device, const vk::raii::PipelineCache *pipeline_cache) const
+{
+    // Vertex components
+    vk::VertexInputBindingDescription binding_description = Vertex::getBindingDescription();
+    auto attribute_descriptions = Vertex::getAttributeDescriptions();
+
+    vk::PipelineVertexInputStateCreateInfo vertex_input_info;
+    vertex_input_info.vertexBindingDescriptionCount = 1;
+    vertex_input_info.pVertexBindingDescriptions = &binding_description;
+    vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
+    vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
+
+    // Dynamic states
+    std::vector dynamic_states = {
+        vk::DynamicState::eViewport,
+        vk::DynamicState::eScissor,
+        vk::DynamicState::eCullMode
+    };
+    vk::PipelineDynamicStateCreateInfo dynamic_state;
+    dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+    dynamic_state.pDynamicStates = dynamic_states.data();
+
+    // Viewport information
+    vk::PipelineViewportStateCreateInfo viewport_state;
+    viewport_state.viewportCount = 1;
+    viewport_state.scissorCount = 1;
+
+    // Color attachments
+    vk::PipelineColorBlendStateCreateInfo color_blending;
+    color_blending.logicOpEnable = vk::False;
+    color_blending.attachmentCount = static_cast<uint32_t>(color_blend_attachments.size());
+    color_blending.pAttachments = color_blend_attachments.data();
+
+    vk::PipelineRenderingCreateInfo rendering_info;
+    rendering_info.colorAttachmentCount = static_cast<uint32_t>(color_formats.size());
+    rendering_info.pColorAttachmentFormats = color_formats.data();
+    rendering_info.depthAttachmentFormat = depth_format;
+
+    vk::GraphicsPipelineCreateInfo pipeline_info;
+    pipeline_info.pNext = &rendering_info;
+    pipeline_info.stageCount = static_cast<uint32_t>(shader_stages.size());
+    pipeline_info.pStages = shader_stages.data();
+    pipeline_info.pVertexInputState = &vertex_input_info;
+    pipeline_info.pInputAssemblyState = &input_assembly;
+    pipeline_info.pViewportState = &viewport_state;
+    pipeline_info.pRasterizationState = &rasterizer;
+    pipeline_info.pColorBlendState = &color_blending;
+    pipeline_info.pDynamicState = &dynamic_state;
+    pipeline_info.layout = layout;
+    pipeline_info.pDepthStencilState = &depth_stencil;
+    pipeline_info.pMultisampleState = &multisampling;
+
+    return vk::raii::Pipeline(logical_device, pipeline_cache, pipeline_info);
+}
+
+// --- PIPELINE COMPILER ---
+
+void PipelineCompiler::create(const vk::raii::Device &logical_device, const vk::raii::PipelineCache *pipeline_cache, uint32_t thread_count)
+{
+    destroy();
+
+    this -> logical_device = &logical_device;
+    this -> pipeline_cache = pipeline_cache;
+
+    stopping = false;
+    for(uint32_t i = 0; i < std::max(thread_count, 1u); i++){
+        threads.emplace_back(&PipelineCompiler::threadLoop, this);
+    }
+}
+
+PipelineTicket PipelineCompiler::submit(GraphicsPipelineState state)
+{
+    if(threads.empty()){
+        throw std::runtime_error("PipelineCompiler used before create!");
+    }
+
+    auto job = std::make_shared<PipelineTicket::Job>();
+    job -> state = std::move(state);
+    job -> submit_time = std::chrono::high_resolution_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.push_back(job);
+    }
+    wake_up.notify_one();
+    return PipelineTicket(job);
+}
+
+void PipelineCompiler::destroy()
+{
+    if(threads.empty()){
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    wake_up.notify_all();
+    for(std::thread &thread : threads){
+        thread.join();
+    }
+    threads.clear();
+
+    if(compiled_count > 0){
+        std::cout << "Pipeline compiler: " << compiled_count << " pipelines, average latency " << total_latency_ms / compiled_count
+                  << " ms, worst " << max_latency_ms << " ms" << std::endl;
+    }
+}
+
+void PipelineCompiler::threadLoop()
+{
+    Profiler::setThreadName("pipeline compiler");
+    while(true){
+        std::shared_ptr<PipelineTicket::Job> job;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            wake_up.wait(lock, [this](){ return stopping || !queue.empty(); });
+            if(queue.empty()){
+                return; // Stopping and nothing left to compile
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        compile(*job);
+    }
+}
+
+void PipelineCompiler::compile(PipelineTicket::Job &job)
+{
+    PROFILE_ZONE("compile pipeline");
+    auto creation_start = std::chrono::high_resolution_clock::now();
+    try{
+        job.pipeline = job.state.create(*logical_device, pipeline_cache);
+    }
+    catch(const vk::SystemError &error){
+        job.error = error.what();
+    }
+    auto creation_end = std::chrono::high_resolution_clock::now();
+
+    job.creation_ms = std::chrono::duration<float, std::milli>(creation_end - creation_start).count();
+    job.latency_ms = std::chrono::duration<float, std::milli>(creation_end - job.submit_time).count();
+
+    compiled_count++;
+    total_latency_ms += job.latency_ms;
+    float max_latency = max_latency_ms.load();
+    while(job.latency_ms > max_latency && !max_latency_ms.compare_exchange_weak(max_latency, job.latency_ms));
+
+    job.done.store(true, std::memory_order_release);
+}
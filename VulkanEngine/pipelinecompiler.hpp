@@ -0,0 +1,109 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+// Everything graphics pipeline creation reads, held by value so the pipeline can be created on another thread
+struct GraphicsPipelineState{
+    std::string name;
+    std::vector<vk::PipelineShaderStageCreateInfo> shader_stages; // Modules owned by the ShaderLibrary
+    vk::PipelineInputAssemblyStateCreateInfo input_assembly = {};
+    vk::PipelineRasterizationStateCreateInfo rasterizer = {};
+    vk::PipelineMultisampleStateCreateInfo multisampling = {};
+    std::vector<vk::PipelineColorBlendAttachmentState> color_blend_attachments;
+    std::vector<vk::Format> color_formats;
+    vk::Format depth_format = vk::Format::eUndefined;
+    vk::PipelineDepthStencilStateCreateInfo depth_stencil = {};
+    vk::PipelineLayout layout = nullptr; // Owned by the bundle the pipeline is for
+
+    // Creates the pipeline. Safe to call from any thread, the pipeline cache is internally synchronized
+    vk::raii::Pipeline create(const vk::raii::Device &logical_device, const vk::raii::PipelineCache *pipeline_cache) const;
+};
+
+// Future of a pipeline compiled by the PipelineCompiler
+class PipelineTicket{
+public:
+    PipelineTicket() = default;
+
+    // False for the empty ticket
+    bool isValid() const { return job != nullptr; }
+    // True once the compilation is over, successful or not
+    bool isReady() const { return job && job -> done.load(std::memory_order_acquire); }
+    bool hasFailed() const { return isReady() && job -> pipeline == nullptr; }
+    const std::string &getError() const { return job -> error; }
+    const std::string &getName() const { return job -> state.name; }
+
+    // Time from submit to ready and time spent inside pipeline creation (ms). Valid once ready
+    float getLatency() const { return job -> latency_ms; }
+    float getCreationTime() const { return job -> creation_ms; }
+
+    // Moves the compiled pipeline out. Must be ready
+    vk::raii::Pipeline take() { return std::move(job -> pipeline); }
+
+private:
+    friend class PipelineCompiler;
+
+    struct Job{
+        GraphicsPipelineState state;
+        vk::raii::Pipeline pipeline = nullptr;
+        std::string error;
+        std::chrono::high_resolution_clock::time_point submit_time;
+        float latency_ms = 0.f;
+        float creation_ms = 0.f;
+        std::atomic<bool> done{false};
+    };
+
+    explicit PipelineTicket(std::shared_ptr<Job> job) : job(std::move(job)) {}
+
+    std::shared_ptr<Job> job;
+};
+
+/**
+ * Background pipeline compilation.
+ * Pipelines are created on threads of their own, not on the JobSystem: the render thread helps the JobSystem
+ * while it waits on the per-frame work and would pick up a compilation, which is exactly the hitch to avoid.
+ * Every compilation goes through the shared pipeline cache.
+ */
+class PipelineCompiler{
+public:
+    PipelineCompiler() = default;
+    ~PipelineCompiler() { destroy(); }
+
+    PipelineCompiler(const PipelineCompiler&) = delete;
+    PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+    // Starts thread_count compile threads. Devices and cache must outlive the compiler
+    void create(const vk::raii::Device &logical_device, const vk::raii::PipelineCache *pipeline_cache, uint32_t thread_count = 1);
+
+    // Queues the creation of a pipeline, returns immediately
+    PipelineTicket submit(GraphicsPipelineState state);
+
+    // Number of pipelines compiled, their summed and worst latency (ms)
+    uint32_t getCompiledCount() const { return compiled_count.load(); }
+    float getTotalLatency() const { return total_latency_ms.load(); }
+    float getMaxLatency() const { return max_latency_ms.load(); }
+
+    // Compiles what is still queued, then joins the threads
+    void destroy();
+
+private:
+    const vk::raii::Device * logical_device = nullptr;
+    const vk::raii::PipelineCache * pipeline_cache = nullptr;
+
+    std::vector<std::thread> threads;
+    std::deque<std::shared_ptr<PipelineTicket::Job>> queue;
+    std::mutex queue_mutex;
+    std::condition_variable wake_up;
+    bool stopping = false;
+
+    std::atomic<uint32_t> compiled_count{0};
+    std::atomic<float> total_latency_ms{0.f};
+    std::atomic<float> max_latency_ms{0.f};
+
+    void threadLoop();
+    void compile(PipelineTicket::Job &job);
+};
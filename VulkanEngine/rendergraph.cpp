@@ -0,0 +1,338 @@
+#include "rendergraph.hpp"
+
+namespace{
+    const vk::AccessFlags2 WRITE_ACCESS = vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+                                          vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+    const vk::AccessFlags2 READ_ACCESS = vk::AccessFlagBits2::eTransferRead | vk::AccessFlagBits2::eIndirectCommandRead |
+                                         vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderSampledRead |
+                                         vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentRead;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::read(ResourceHandle resource, ResourceUsage usage)
+{
+    accesses.push_back(Access{resource, usage, false});
+    return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::write(ResourceHandle resource, ResourceUsage usage)
+{
+    accesses.push_back(Access{resource, usage, true});
+    return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::setSideEffect()
+{
+    side_effect = true;
+    return *this;
+}
+
+RenderGraph::Pass &RenderGraph::Pass::setExecute(std::function<void(vk::raii::CommandBuffer &)> record)
+{
+    this -> record = std::move(record);
+    return *this;
+}
+
+void RenderGraph::reset()
+{
+    resources.clear();
+    passes.clear();
+}
+
+ResourceHandle RenderGraph::importImage(const char *name, vk::Image image, vk::ImageAspectFlags aspect, uint32_t level_count, uint32_t layer_count,
+                                        const ImageState &initial, const std::optional<ImageState> &final_state)
+{
+    Resource &resource = resources.emplace_back();
+    resource.name = name;
+    resource.is_image = true;
+    resource.image = image;
+    resource.range = vk::ImageSubresourceRange(aspect, 0, level_count, 0, layer_count);
+    resource.final_state = final_state;
+    resource.state.layout = initial.layout;
+    resource.state.write_stages = initial.stages;
+    resource.state.write_access = initial.access;
+    return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+ResourceHandle RenderGraph::importBuffer(const char *name, vk::Buffer buffer, bool output)
+{
+    Resource &resource = resources.emplace_back();
+    resource.name = name;
+    resource.buffer = buffer;
+    resource.output = output;
+    return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+ResourceHandle RenderGraph::createImage(const char *name, vk::Format format, vk::Extent2D extent, vk::SampleCountFlagBits samples)
+{
+    Resource &resource = resources.emplace_back();
+    resource.name = name;
+    resource.is_image = true;
+    resource.transient = true;
+    resource.desc.format = format;
+    resource.desc.extent = extent;
+    resource.desc.samples = samples;
+    resource.range = vk::ImageSubresourceRange(TransientAllocator::getAspect(format), 0, 1, 0, 1);
+    return static_cast<ResourceHandle>(resources.size() - 1);
+}
+
+RenderGraph::Pass &RenderGraph::addPass(const char *name)
+{
+    Pass &pass = passes.emplace_back();
+    pass.name = name;
+    return pass;
+}
+
+void RenderGraph::execute(vk::raii::CommandBuffer &command_buffer, GpuProfiler *profiler)
+{
+    culled_passes = 0;
+    barrier_batches = 0;
+    cullPasses();
+    allocateTransients();
+
+    for(uint32_t pass_index = 0; pass_index < passes.size(); pass_index++){
+        Pass &pass = passes[pass_index];
+        if(!pass.alive){
+            culled_passes++;
+            continue;
+        }
+
+        // A resource used several ways by the pass gets one barrier covering every use
+        merged_accesses.clear();
+        for(const Pass::Access &access : pass.accesses){
+            UsageInfo info = getUsageInfo(access.usage);
+            auto merged = std::find_if(merged_accesses.begin(), merged_accesses.end(),
+                                       [&](const MergedAccess &other){ return other.resource == access.resource; });
+            if(merged == merged_accesses.end()){
+                merged_accesses.push_back(MergedAccess{access.resource, info, access.write});
+                continue;
+            }
+            if(resources[access.resource].is_image && merged -> info.layout != info.layout){
+                throw std::runtime_error(std::string("Pass ") + pass.name + " uses " + resources[access.resource].name + " in two layouts!");
+            }
+            merged -> info.stages |= info.stages;
+            merged -> info.access |= info.access;
+            merged -> write = merged -> write || access.write;
+        }
+        for(const MergedAccess &access : merged_accesses){
+            Resource &resource = resources[access.resource];
+            if(resource.transient && resource.first_pass == pass_index){
+                // The memory was last used by the images aliasing this one, their content is discarded after they are done
+                for(ResourceHandle alias : resource.aliases){
+                    const ResourceState &alias_state = resources[alias].state;
+                    resource.state.write_stages |= alias_state.write_stages | alias_state.read_stages;
+                    resource.state.write_access |= alias_state.write_access;
+                }
+            }
+            addBarrier(resource, access.info, access.write);
+        }
+        flushBarriers(command_buffer);
+
+        uint32_t zone = profiler ? profiler -> beginZone(command_buffer, pass.name) : UINT32_MAX;
+        if(pass.record){
+            pass.record(command_buffer);
+        }
+        if(profiler){
+            profiler -> endZone(command_buffer, zone);
+        }
+    }
+
+    // Hand the images over in the state expected after the graph
+    for(Resource &resource : resources){
+        if(!resource.final_state){
+            continue;
+        }
+        const ImageState &final_state = *resource.final_state;
+        ResourceState &state = resource.state;
+        if(state.layout == final_state.layout && final_state.stages == vk::PipelineStageFlagBits2::eNone){
+            continue;
+        }
+        image_barriers.push_back(vk::ImageMemoryBarrier2(
+            state.write_stages | state.read_stages, state.write_access, final_state.stages, final_state.access,
+            state.layout, final_state.layout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, resource.image, resource.range));
+        state = ResourceState();
+        state.layout = final_state.layout;
+    }
+    flushBarriers(command_buffer);
+}
+
+RenderGraph::UsageInfo RenderGraph::getUsageInfo(ResourceUsage usage)
+{
+    switch(usage){
+        case ResourceUsage::TRANSFER_READ:
+            return {vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferRead, vk::ImageLayout::eTransferSrcOptimal,
+                    vk::ImageUsageFlagBits::eTransferSrc};
+        case ResourceUsage::TRANSFER_WRITE:
+            return {vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eTransferDstOptimal,
+                    vk::ImageUsageFlagBits::eTransferDst};
+        case ResourceUsage::INDIRECT_READ:
+            return {vk::PipelineStageFlagBits2::eDrawIndirect, vk::AccessFlagBits2::eIndirectCommandRead, vk::ImageLayout::eUndefined,
+                    vk::ImageUsageFlags()};
+        case ResourceUsage::VERTEX_READ:
+            return {vk::PipelineStageFlagBits2::eVertexShader, vk::AccessFlagBits2::eShaderStorageRead, vk::ImageLayout::eGeneral,
+                    vk::ImageUsageFlagBits::eStorage};
+        case ResourceUsage::FRAGMENT_SAMPLED:
+            return {vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead, vk::ImageLayout::eShaderReadOnlyOptimal,
+                    vk::ImageUsageFlagBits::eSampled};
+        case ResourceUsage::COMPUTE_READ:
+            return {vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead, vk::ImageLayout::eGeneral,
+                    vk::ImageUsageFlagBits::eStorage};
+        case ResourceUsage::COMPUTE_WRITE:
+            return {vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+                    vk::ImageLayout::eGeneral, vk::ImageUsageFlagBits::eStorage};
+        case ResourceUsage::COLOR_ATTACHMENT:
+            return {vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eColorAttachmentWrite, vk::ImageLayout::eColorAttachmentOptimal,
+                    vk::ImageUsageFlagBits::eColorAttachment};
+        case ResourceUsage::DEPTH_ATTACHMENT:
+            return {vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                    vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                    vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment};
+        case ResourceUsage::DEPTH_READ:
+            return {vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                    vk::AccessFlagBits2::eDepthStencilAttachmentRead, vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+                    vk::ImageUsageFlagBits::eDepthStencilAttachment};
+    }
+    throw std::runtime_error("Unknown resource usage!");
+}
+
+void RenderGraph::cullPasses()
+{
+    // Walk back from the outputs: a pass lives when a live pass or the outside consumes something it writes
+    for(Resource &resource : resources){
+        resource.needed = resource.output || resource.final_state.has_value();
+    }
+
+    for(auto pass = passes.rbegin(); pass != passes.rend(); pass++){
+        pass -> alive = pass -> side_effect;
+        for(const Pass::Access &access : pass -> accesses){
+            if(access.write && resources[access.resource].needed){
+                pass -> alive = true;
+            }
+        }
+        if(!pass -> alive){
+            continue;
+        }
+
+        // Whatever it reads, including the old content of what it modifies, must be produced first
+        for(const Pass::Access &access : pass -> accesses){
+            if(!access.write || (getUsageInfo(access.usage).access & READ_ACCESS)){
+                resources[access.resource].needed = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::allocateTransients()
+{
+    transient_requests.clear();
+    transient_resources.clear();
+    for(Resource &resource : resources){
+        resource.first_pass = UINT32_MAX;
+        resource.last_pass = 0;
+        resource.desc.usage = {};
+    }
+
+    for(uint32_t pass_index = 0; pass_index < passes.size(); pass_index++){
+        if(!passes[pass_index].alive){
+            continue;
+        }
+        for(const Pass::Access &access : passes[pass_index].accesses){
+            Resource &resource = resources[access.resource];
+            if(!resource.transient){
+                continue;
+            }
+            resource.first_pass = std::min(resource.first_pass, pass_index);
+            resource.last_pass = pass_index;
+            resource.desc.usage |= getUsageInfo(access.usage).image_usage;
+        }
+    }
+
+    for(ResourceHandle handle = 0; handle < resources.size(); handle++){
+        const Resource &resource = resources[handle];
+        if(resource.transient && resource.first_pass != UINT32_MAX){
+            transient_requests.push_back(TransientRequest{resource.desc, resource.first_pass, resource.last_pass});
+            transient_resources.push_back(handle);
+        }
+    }
+    if(transient_requests.empty()){
+        return;
+    }
+    if(!transient_allocator){
+        throw std::runtime_error("Render graph has transient images but no transient allocator!");
+    }
+
+    const std::vector<TransientImage> &images = transient_allocator -> allocate(transient_requests);
+    for(size_t i = 0; i < images.size(); i++){
+        Resource &resource = resources[transient_resources[i]];
+        resource.image = images[i].image;
+        resource.view = images[i].view;
+        resource.aliases.clear();
+        for(uint32_t alias : images[i].aliases){
+            resource.aliases.push_back(transient_resources[alias]);
+        }
+    }
+}
+
+void RenderGraph::addBarrier(Resource &resource, const UsageInfo &info, bool write)
+{
+    ResourceState &state = resource.state;
+    const vk::ImageLayout old_layout = state.layout;
+    const bool layout_change = resource.is_image && info.layout != old_layout;
+
+    vk::PipelineStageFlags2 src_stages = vk::PipelineStageFlagBits2::eNone;
+    vk::AccessFlags2 src_access = vk::AccessFlagBits2::eNone;
+    if(write || layout_change){
+        // Waits on the last write and, execution only, on the reads since then
+        src_stages = state.write_stages | state.read_stages;
+        src_access = state.write_access;
+        const bool first_use = src_stages == vk::PipelineStageFlagBits2::eNone;
+
+        // A layout transition is a write as well, later uses are ordered after it
+        state.write_stages = info.stages;
+        state.write_access = write ? info.access & WRITE_ACCESS : vk::AccessFlagBits2::eNone;
+        state.read_stages = write ? vk::PipelineStageFlagBits2::eNone : info.stages;
+        state.read_access = write ? vk::AccessFlagBits2::eNone : info.access;
+        state.layout = resource.is_image ? info.layout : old_layout;
+
+        if(first_use && !layout_change){
+            return; // Nothing to wait on
+        }
+    }
+    else{
+        // Reads of a write already made visible to these stages need nothing
+        bool visible = (state.read_stages & info.stages) == info.stages && (state.read_access & info.access) == info.access;
+        if(visible || state.write_stages == vk::PipelineStageFlagBits2::eNone){
+            state.read_stages |= info.stages;
+            state.read_access |= info.access;
+            return;
+        }
+        src_stages = state.write_stages;
+        src_access = state.write_access;
+        state.read_stages |= info.stages;
+        state.read_access |= info.access;
+    }
+
+    if(resource.is_image){
+        image_barriers.push_back(vk::ImageMemoryBarrier2(src_stages, src_access, info.stages, info.access,
+            old_layout, info.layout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, resource.image, resource.range));
+    }
+    else{
+        buffer_barriers.push_back(vk::BufferMemoryBarrier2(src_stages, src_access, info.stages, info.access,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, resource.buffer, 0, VK_WHOLE_SIZE));
+    }
+}
+
+void RenderGraph::flushBarriers(vk::raii::CommandBuffer &command_buffer)
+{
+    if(image_barriers.empty() && buffer_barriers.empty()){
+        return;
+    }
+
+    vk::DependencyInfo dependency_info;
+    dependency_info.setBufferMemoryBarriers(buffer_barriers);
+    dependency_info.setImageMemoryBarriers(image_barriers);
+    command_buffer.pipelineBarrier2(dependency_info);
+    barrier_batches++;
+
+    image_barriers.clear();
+    buffer_barriers.clear();
+}
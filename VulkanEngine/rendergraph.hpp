@@ -0,0 +1,167 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+#include "gpuprofiler.hpp"
+#include "transientallocator.hpp"
+
+#include <functional>
+
+// How a pass uses a resource. Stages, access and image layout of each usage are derived by the graph
+enum class ResourceUsage{
+    TRANSFER_READ,
+    TRANSFER_WRITE,
+    INDIRECT_READ, // Draw or dispatch parameters
+    VERTEX_READ, // Storage buffer read by the vertex shader
+    FRAGMENT_SAMPLED, // Image sampled by the fragment shader
+    COMPUTE_READ,
+    COMPUTE_WRITE, // Storage read and write by a compute shader
+    COLOR_ATTACHMENT, // Cleared or fully overwritten. Blending or loading the old content is not covered
+    DEPTH_ATTACHMENT,
+    DEPTH_READ // Depth test without writes
+};
+
+// Synchronization state of an image outside of the graph: the state it is imported in, or left in at the end
+struct ImageState{
+    vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eNone; // Last (or first, when final) stages using it
+    vk::AccessFlags2 access = vk::AccessFlagBits2::eNone;
+};
+
+using ResourceHandle = uint32_t;
+
+/**
+ * Per-frame render graph.
+ * Resources are imported each frame, passes are declared in submission order with the usage of every resource they
+ * touch and a function recording their commands. execute() culls the passes whose results nothing consumes, then
+ * records the others with a single pipelineBarrier2 before each pass, holding exactly the dependencies its usages
+ * need on the previous ones: layout transitions, write to read/write hazards and execution-only write-after-read.
+ * Reads of an already visible write need no barrier. Images are transitioned over their whole subresource range.
+ * Images created by the graph are transient: they live from the first to the last kept pass using them, and get their
+ * memory from the transient allocator, aliased with the transient images living in other passes. Their first use starts
+ * from undefined content and waits for the last uses of the images aliasing them.
+ * The graph is declared again every frame and keeps its storage between frames.
+ */
+class RenderGraph{
+public:
+    class Pass{
+    public:
+        Pass &read(ResourceHandle resource, ResourceUsage usage);
+        Pass &write(ResourceHandle resource, ResourceUsage usage);
+
+        // Kept even if nothing reads what it writes
+        Pass &setSideEffect();
+
+        Pass &setExecute(std::function<void(vk::raii::CommandBuffer &)> record);
+
+    private:
+        friend class RenderGraph;
+
+        struct Access{
+            ResourceHandle resource;
+            ResourceUsage usage;
+            bool write;
+        };
+
+        const char * name = nullptr;
+        std::vector<Access> accesses;
+        std::function<void(vk::raii::CommandBuffer &)> record;
+        bool side_effect = false;
+        bool alive = false;
+    };
+
+    // Forgets the passes and resources of the previous frame
+    void reset();
+
+    // An image used by the passes. It is found in initial, and left in final when given (only then are its passes kept)
+    ResourceHandle importImage(const char *name, vk::Image image, vk::ImageAspectFlags aspect, uint32_t level_count, uint32_t layer_count,
+                               const ImageState &initial, const std::optional<ImageState> &final_state = std::nullopt);
+
+    // A buffer used by the passes. Its passes are only kept when output is set or when a kept pass reads it
+    ResourceHandle importBuffer(const char *name, vk::Buffer buffer, bool output = false);
+
+    // An image owned by the graph for this frame, single level and layer. Its usage flags follow from the passes using it
+    ResourceHandle createImage(const char *name, vk::Format format, vk::Extent2D extent,
+                               vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1);
+
+    // Where transient images get their memory. Must be set before executing a graph creating images
+    void setTransientAllocator(TransientAllocator *allocator) { transient_allocator = allocator; }
+
+    // View of a graph image, valid while the passes record
+    vk::ImageView getImageView(ResourceHandle resource) const { return resources[resource].view; }
+
+    // Adds a pass after the ones already declared. name must outlive the graph (a string literal).
+    // The reference is valid until the next addPass
+    Pass &addPass(const char *name);
+
+    // Culls, then records the kept passes and their barriers. Each pass is a GPU zone of profiler when given
+    void execute(vk::raii::CommandBuffer &command_buffer, GpuProfiler *profiler = nullptr);
+
+    // Counts of the last execute
+    uint32_t getCulledPassCount() const { return culled_passes; }
+    uint32_t getBarrierCount() const { return barrier_batches; }
+
+private:
+    struct UsageInfo{
+        vk::PipelineStageFlags2 stages;
+        vk::AccessFlags2 access;
+        vk::ImageLayout layout; // Ignored for buffers
+        vk::ImageUsageFlags image_usage; // Flags a transient image needs for it
+    };
+
+    // Where a resource stands while recording
+    struct ResourceState{
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        vk::PipelineStageFlags2 write_stages = vk::PipelineStageFlagBits2::eNone; // Last write, or the import
+        vk::AccessFlags2 write_access = vk::AccessFlagBits2::eNone;
+        vk::PipelineStageFlags2 read_stages = vk::PipelineStageFlagBits2::eNone; // Reads since then, the write is visible to them
+        vk::AccessFlags2 read_access = vk::AccessFlagBits2::eNone;
+    };
+
+    struct Resource{
+        const char * name = nullptr;
+        bool is_image = false;
+        vk::Image image = nullptr;
+        vk::Buffer buffer = nullptr;
+        vk::ImageSubresourceRange range;
+        std::optional<ImageState> final_state;
+        bool output = false;
+        bool needed = false;
+        ResourceState state;
+
+        // Transient images only
+        bool transient = false;
+        TransientImageDesc desc;
+        vk::ImageView view = nullptr;
+        uint32_t first_pass = UINT32_MAX; // Kept passes using it, UINT32_MAX when none
+        uint32_t last_pass = 0;
+        std::vector<ResourceHandle> aliases;
+    };
+
+    // Every use of one resource by a pass, merged
+    struct MergedAccess{
+        ResourceHandle resource;
+        UsageInfo info;
+        bool write;
+    };
+
+    std::vector<Resource> resources;
+    std::vector<Pass> passes;
+    std::vector<MergedAccess> merged_accesses;
+    std::vector<vk::ImageMemoryBarrier2> image_barriers;
+    std::vector<vk::BufferMemoryBarrier2> buffer_barriers;
+    TransientAllocator *transient_allocator = nullptr;
+    std::vector<TransientRequest> transient_requests;
+    std::vector<ResourceHandle> transient_resources; // Resource of each request
+    uint32_t culled_passes = 0;
+    uint32_t barrier_batches = 0;
+
+    static UsageInfo getUsageInfo(ResourceUsage usage);
+
+    void cullPasses();
+    // Computes the pass range of the transient images used by kept passes and binds them to their memory
+    void allocateTransients();
+    // Adds the barrier needed before resource is used with info, if any, and moves its state past the use
+    void addBarrier(Resource &resource, const UsageInfo &info, bool write);
+    // Records the barriers gathered so far in a single call
+    void flushBarriers(vk::raii::CommandBuffer &command_buffer);
+};
@@ -0,0 +1,228 @@
+#include "shaderlibrary.hpp"
+
+#include <filesystem>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+// --- MAPPED FILE ---
+
+MappedFile::MappedFile(const std::string &path)
+{
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if(descriptor < 0){
+        throw std::runtime_error("failed to open file: " + path);
+    }
+
+    struct stat file_stat;
+    if(fstat(descriptor, &file_stat) != 0){
+        close(descriptor);
+        throw std::runtime_error("failed to stat file: " + path);
+    }
+    file_size = static_cast<size_t>(file_stat.st_size);
+
+    if(file_size > 0){
+        mapped = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if(mapped == MAP_FAILED){
+            mapped = nullptr;
+            close(descriptor);
+            throw std::runtime_error("failed to map file: " + path);
+        }
+    }
+    close(descriptor); // The mapping stays valid
+}
+
+MappedFile::~MappedFile()
+{
+    if(mapped){
+        munmap(mapped, file_size);
+    }
+}
+
+// --- SHADER LIBRARY ---
+
+void ShaderLibrary::create(vk::raii::Device &logical_device, std::string cache_directory)
+{
+    this -> logical_device = &logical_device;
+    this -> cache_directory = std::move(cache_directory);
+}
+
+vk::ShaderModule ShaderLibrary::load(const std::string &spirv_path)
+{
+    auto known = path_modules.find(spirv_path);
+    if(known != path_modules.end()){
+        return known -> second;
+    }
+
+    // A binary built before its source was edited no longer matches the pipeline layouts, refuse it
+    std::filesystem::path source_path = std::filesystem::path(spirv_path).replace_extension();
+    if(std::filesystem::path(spirv_path).extension() == ".spv" && std::filesystem::exists(source_path) &&
+       std::filesystem::last_write_time(source_path) > std::filesystem::last_write_time(spirv_path)){
+        throw std::runtime_error("SPIR-V older than its source, run make shaders: " + spirv_path);
+    }
+
+    // Page aligned, so the mapping can be handed to the driver as SPIR-V words
+    MappedFile file(spirv_path);
+    if(file.size() == 0 || file.size() % 4 != 0){
+        throw std::runtime_error("invalid SPIR-V file: " + spirv_path);
+    }
+
+    uint64_t hash = hashFNV1a(file.data(), file.size());
+    vk::ShaderModule module = getModule(static_cast<const uint32_t *>(file.data()), file.size(), hash);
+    path_modules[spirv_path] = module;
+    return module;
+}
+
+vk::ShaderModule ShaderLibrary::loadVariant(const std::string &source_path, const std::vector<std::string> &defines)
+{
+    // Defines reach glslc as -D arguments, only plain macro names and values are accepted
+    for(const std::string &define : defines){
+        if(define.empty() || define.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_=") != std::string::npos){
+            throw std::runtime_error("invalid shader define: " + define);
+        }
+    }
+
+    // The stage comes from the extension (.vert, .frag, .comp ...), glslc reads it the same way
+    std::string stage = std::filesystem::path(source_path).extension().string();
+
+    // Editing an included file must give a new variant as well
+    std::vector<std::string> visited;
+    uint64_t hash = hashSource(source_path, 0xcbf29ce484222325ull, visited);
+    hash = hashFNV1a(stage.data(), stage.size(), hash);
+    for(const std::string &define : defines){
+        hash = hashFNV1a(define.data(), define.size() + 1, hash); // Includes the terminator, so "AB","C" differs from "A","BC"
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    std::filesystem::path spirv_path = std::filesystem::path(cache_directory) / (std::string(name) + stage + ".spv");
+
+    if(!std::filesystem::exists(spirv_path)){
+        std::filesystem::create_directories(cache_directory);
+
+        // Compiled next to the final file and renamed, so a failed compile never leaves a broken variant
+        std::string temporary_path = spirv_path.string() + ".tmp";
+        std::vector<std::string> arguments{"glslc", source_path, "-o", temporary_path};
+        for(const std::string &define : defines){
+            arguments.push_back("-D" + define);
+        }
+        std::vector<char *> argv;
+        for(std::string &argument : arguments){
+            argv.push_back(argument.data());
+        }
+        argv.push_back(nullptr);
+
+        // Run directly, no shell sees the paths or the defines
+        auto compile_start = std::chrono::high_resolution_clock::now();
+        pid_t pid;
+        int status = 0;
+        bool compiled = posix_spawnp(&pid, "glslc", nullptr, nullptr, argv.data(), environ) == 0 &&
+                        waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if(!compiled){
+            std::remove(temporary_path.c_str());
+            throw std::runtime_error("failed to compile shader variant of " + source_path);
+        }
+        std::filesystem::rename(temporary_path, spirv_path);
+        float compile_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - compile_start).count();
+        std::cout << "Compiled shader variant " << spirv_path.string() << " in " << compile_ms << " ms" << std::endl;
+    }
+
+    return load(spirv_path.string());
+}
+
+const vk::SpecializationInfo *ShaderLibrary::getSpecializationInfo(const ShaderSpecialization &specialization)
+{
+    if(specialization.empty()){
+        return nullptr;
+    }
+
+    uint64_t hash = hashFNV1a(specialization.entries.data(), sizeof(vk::SpecializationMapEntry) * specialization.entries.size());
+    hash = hashFNV1a(specialization.data.data(), specialization.data.size(), hash);
+
+    std::unique_ptr<SpecializationEntry> &entry = specializations[hash];
+    if(!entry){
+        entry = std::make_unique<SpecializationEntry>();
+        entry -> entries = specialization.entries;
+        entry -> data = specialization.data;
+        entry -> info = vk::SpecializationInfo(static_cast<uint32_t>(entry -> entries.size()), entry -> entries.data(),
+                                               entry -> data.size(), entry -> data.data());
+    }
+    return &entry -> info;
+}
+
+void ShaderLibrary::destroy()
+{
+    modules.clear();
+    path_modules.clear();
+    specializations.clear();
+}
+
+vk::ShaderModule ShaderLibrary::getModule(const uint32_t *code, size_t size, uint64_t hash)
+{
+    // Same hash is only the same module when the code matches too
+    auto [first, last] = modules.equal_range(hash);
+    for(auto it = first; it != last; it++){
+        const std::vector<uint32_t> &known_code = it -> second.code;
+        if(known_code.size() * sizeof(uint32_t) == size && std::memcmp(known_code.data(), code, size) == 0){
+            return *it -> second.module;
+        }
+    }
+
+    vk::ShaderModuleCreateInfo create_info;
+    create_info.codeSize = size;
+    create_info.pCode = code;
+
+    ModuleEntry entry{std::vector<uint32_t>(code, code + size / sizeof(uint32_t)), vk::raii::ShaderModule(*logical_device, create_info)};
+    auto inserted = modules.emplace(hash, std::move(entry));
+    return *inserted -> second.module;
+}
+
+uint64_t ShaderLibrary::hashSource(const std::string &path, uint64_t seed, std::vector<std::string> &visited)
+{
+    std::string canonical = std::filesystem::weakly_canonical(path).string();
+    if(std::find(visited.begin(), visited.end(), canonical) != visited.end()){
+        return seed; // Included twice or in a cycle, counted once
+    }
+    visited.push_back(canonical);
+
+    MappedFile source(path);
+    uint64_t hash = hashFNV1a(source.data(), source.size(), seed);
+
+    // Includes are resolved next to the including file, as glslc does without -I
+    std::string_view text(static_cast<const char *>(source.data()), source.size());
+    size_t line_start = 0;
+    while(line_start < text.size()){
+        size_t line_end = text.find('\n', line_start);
+        if(line_end == std::string_view::npos){
+            line_end = text.size();
+        }
+        std::string_view line = text.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        size_t directive = line.find_first_not_of(" \t");
+        if(directive == std::string_view::npos || line.substr(directive, 8) != "#include"){
+            continue;
+        }
+        size_t open = line.find_first_of("\"<", directive + 8);
+        if(open == std::string_view::npos){
+            continue;
+        }
+        size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+        if(close == std::string_view::npos){
+            continue;
+        }
+        std::filesystem::path included = std::filesystem::path(path).parent_path() / std::string(line.substr(open + 1, close - open - 1));
+        if(std::filesystem::exists(included)){
+            hash = hashSource(included.string(), hash, visited); // A missing one is reported by glslc
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include <unordered_map>
+
+// Values of the specialization constants of one shader permutation
+struct ShaderSpecialization{
+    std::vector<vk::SpecializationMapEntry> entries;
+    std::vector<uint8_t> data;
+
+    // Sets constant_id to value (32-bit scalar: int, uint, float or bool)
+    template<typename T>
+    ShaderSpecialization &set(uint32_t constant_id, T value){
+        static_assert(sizeof(T) == 4, "Specialization constants are 32-bit scalars");
+        entries.push_back(vk::SpecializationMapEntry(constant_id, static_cast<uint32_t>(data.size()), sizeof(T)));
+        const uint8_t * bytes = reinterpret_cast<const uint8_t *>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+        return *this;
+    }
+
+    bool empty() const { return entries.empty(); }
+};
+
+/**
+ * Owner of every shader module.
+ * SPIR-V files are memory-mapped and hashed, so the same code is turned into one VkShaderModule however many
+ * pipelines (or paths) use it. Permutations come in two forms:
+ *  - specialization constants: one module, the constants are baked in at pipeline creation and the
+ *    compiled result is kept on disk by the PipelineCache
+ *  - preprocessor defines: the GLSL source is compiled with glslc once per set of defines and the SPIR-V
+ *    is stored in cache_directory, keyed by the hash of the source with its includes, stage and defines
+ */
+class ShaderLibrary{
+public:
+    void create(vk::raii::Device &logical_device, std::string cache_directory = "shader_cache");
+
+    // Returns the module of a SPIR-V file, creating it only if no loaded module has the same code.
+    // Throws when the GLSL source next to it (the path without .spv) is newer
+    vk::ShaderModule load(const std::string &spirv_path);
+
+    // Returns the module of a GLSL source compiled with the given defines ("NAME" or "NAME=VALUE", letters, digits and
+    // underscores only). Uses the SPIR-V cached on disk when there is one, otherwise runs glslc
+    vk::ShaderModule loadVariant(const std::string &source_path, const std::vector<std::string> &defines);
+
+    // Stable specialization info for the constants, shared by every pipeline using the same values. nullptr when empty
+    const vk::SpecializationInfo *getSpecializationInfo(const ShaderSpecialization &specialization);
+
+    // Number of distinct modules
+    uint32_t getModuleCount() const { return static_cast<uint32_t>(modules.size()); }
+
+    // Destroys every module. Pipelines already built keep working
+    void destroy();
+
+private:
+    struct SpecializationEntry{
+        std::vector<vk::SpecializationMapEntry> entries;
+        std::vector<uint8_t> data;
+        vk::SpecializationInfo info;
+    };
+
+    vk::raii::Device * logical_device = nullptr;
+    std::string cache_directory;
+
+    struct ModuleEntry{
+        std::vector<uint32_t> code; // Compared on a hash hit, so a collision never hands out another shader
+        vk::raii::ShaderModule module;
+    };
+
+    std::unordered_multimap<uint64_t, ModuleEntry> modules; // By hash of the SPIR-V
+    std::unordered_map<std::string, vk::ShaderModule> path_modules; // Files already mapped
+    std::unordered_map<uint64_t, std::unique_ptr<SpecializationEntry>> specializations; // By hash of entries and data
+
+    // Returns the module with the given code (size in bytes), creating it if needed
+    vk::ShaderModule getModule(const uint32_t *code, size_t size, uint64_t hash);
+
+    // Hashes a GLSL file and, recursively, the files it includes. visited holds the files already hashed
+    static uint64_t hashSource(const std::string &path, uint64_t seed, std::vector<std::string> &visited);
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile{
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const void *data() const { return mapped; }
+    size_t size() const { return file_size; }
+
+private:
+    void * mapped = nullptr;
+    size_t file_size = 0;
+};
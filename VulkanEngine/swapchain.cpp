@@ -1,6 +1,7 @@
 #include "swapchain.hpp"
 
-SwapchainBundle Swapchain::createSwapchain(vk::raii::PhysicalDevice &physical_device, vk::raii::Device& logical_device, vk::raii::SurfaceKHR &surface, GLFWwindow * window, QueuePool& queue_indices){
+SwapchainBundle Swapchain::createSwapchain(vk::raii::PhysicalDevice &physical_device, vk::raii::Device& logical_device, vk::raii::SurfaceKHR &surface, GLFWwindow * window, QueuePool& queue_indices,
+                                           vk::SwapchainKHR old_swapchain){
     SwapchainBundle swapchain;
 
     vk::SurfaceCapabilitiesKHR surface_capabilities = physical_device.getSurfaceCapabilitiesKHR(surface);
@@ -30,6 +31,7 @@ SwapchainBundle Swapchain::createSwapchain(vk::raii::PhysicalDevice &physical_de
     swapchain_create_info.presentMode = swapchain.present_mode;
     swapchain_create_info.clipped = true; // If a pixel is obscured by another window, Vulkan won't bother rendering it.
     swapchain_create_info.imageExtent = swapchain.extent;
+    swapchain_create_info.oldSwapchain = old_swapchain;
 
     if(queue_family_indices[0] != queue_family_indices[1]){
         // Allows multiple queue families to access the images simultaneously without explicit ownership tansfers. Easier to code but less performant
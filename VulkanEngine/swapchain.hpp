@@ -4,7 +4,9 @@
 #include "../Helpers/GLFWhelper.hpp"
 
 namespace Swapchain{
-    SwapchainBundle createSwapchain(vk::raii::PhysicalDevice &physical_device, vk::raii::Device& logical_device, vk::raii::SurfaceKHR &surface, GLFWwindow * window, QueuePool& queue_indices);
+    // old_swapchain is the one being replaced, if any. The driver can reuse its resources and it stays valid until destroyed
+    SwapchainBundle createSwapchain(vk::raii::PhysicalDevice &physical_device, vk::raii::Device& logical_device, vk::raii::SurfaceKHR &surface, GLFWwindow * window, QueuePool& queue_indices,
+                                    vk::SwapchainKHR old_swapchain = nullptr);
 
     // Helper function to extract a suitable format for the swapchain
     vk::Format chooseSwapSurfaceFormat(std::vector<vk::SurfaceFormatKHR> available_formats);
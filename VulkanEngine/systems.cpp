@@ -0,0 +1,97 @@
+#include "systems.hpp"
+#include "cpuprofiler.hpp"
+
+void Systems::integrateVelocities(ECS::World &world, float dtime, JobSystem &jobs)
+{
+    PROFILE_ZONE("integrate velocities");
+    static thread_local std::vector<ECS::ChunkRef> chunks;
+    world.collectChunks<Transform, Velocity>(chunks);
+
+    forEachChunk<Transform, Velocity>(chunks, jobs, [dtime](uint32_t count, Transform * transforms, Velocity * velocities){
+        for(uint32_t i = 0; i < count; i++){
+            const Velocity &velocity = velocities[i];
+            if(velocity.linear == glm::vec3(0.f) && velocity.angular == glm::vec3(0.f) && velocity.scale == glm::vec3(0.f)){
+                continue; // Static entities keep their cached matrix
+            }
+
+            Transform &transform = transforms[i];
+            transform.position += velocity.linear * dtime;
+            transform.rotation += velocity.angular * dtime;
+            transform.scale += velocity.scale * dtime;
+            transform.dirty = true;
+        }
+    });
+}
+
+void Systems::updateTransforms(ECS::World &world, JobSystem &jobs)
+{
+    PROFILE_ZONE("update transforms");
+    static thread_local std::vector<ECS::ChunkRef> chunks;
+    world.collectChunks<Transform, ModelMatrix, Bounds>(chunks);
+
+    // Reused across frames so the batch never reallocates once warm, one set per thread
+    static thread_local Transforms::TRSBatch batch;
+    static thread_local std::vector<uint32_t> dirty_rows;
+    static thread_local std::vector<glm::mat4> dirty_models;
+
+    forEachChunk<Transform, ModelMatrix, Bounds>(chunks, jobs, [](uint32_t count, Transform * transforms, ModelMatrix * matrices, Bounds * bounds){
+        batch.clear();
+        dirty_rows.clear();
+        for(uint32_t i = 0; i < count; i++){
+            if(transforms[i].dirty){
+                transforms[i].dirty = false;
+                batch.push(transforms[i].position, transforms[i].rotation, transforms[i].scale);
+                dirty_rows.push_back(i);
+            }
+        }
+        if(dirty_rows.empty()){
+            return;
+        }
+
+        // A fully dirty chunk is written in place, otherwise the matrices go through a scratch array
+        static_assert(sizeof(ModelMatrix) == sizeof(glm::mat4), "ModelMatrix arrays are written as glm::mat4 arrays");
+        if(dirty_rows.size() == count){
+            Transforms::computeModelMatrices(batch, reinterpret_cast<glm::mat4 *>(matrices));
+        }
+        else{
+            dirty_models.resize(dirty_rows.size());
+            Transforms::computeModelMatrices(batch, dirty_models.data());
+            for(size_t j = 0; j < dirty_rows.size(); j++){
+                matrices[dirty_rows[j]].model = dirty_models[j];
+            }
+        }
+
+        for(uint32_t i : dirty_rows){
+            // The sphere radius grows with the largest scale axis
+            const glm::mat4 &model = matrices[i].model;
+            const glm::vec4 &local_sphere = bounds[i].local_sphere;
+            glm::vec3 sphere_center = glm::vec3(model * glm::vec4(glm::vec3(local_sphere), 1.f));
+            float max_scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+            bounds[i].world_sphere = glm::vec4(sphere_center, local_sphere.w * max_scale);
+
+            // The box extent is projected on the world axes through the absolute rotation-scale part
+            glm::vec3 box_center = glm::vec3(model * glm::vec4((bounds[i].local_min + bounds[i].local_max) * 0.5f, 1.f));
+            glm::vec3 box_extent = (bounds[i].local_max - bounds[i].local_min) * 0.5f;
+            glm::vec3 world_extent = glm::abs(glm::vec3(model[0])) * box_extent.x +
+                                     glm::abs(glm::vec3(model[1])) * box_extent.y +
+                                     glm::abs(glm::vec3(model[2])) * box_extent.z;
+            bounds[i].world_min = box_center - world_extent;
+            bounds[i].world_max = box_center + world_extent;
+        }
+    });
+}
+
+glm::mat4 Systems::computeModelMatrix(const Transform &transform)
+{
+    glm::mat4 model = glm::translate(glm::mat4(1.f), transform.position);
+    if(transform.rotation.x != 0.0){
+        model = glm::rotate(model, glm::radians(transform.rotation.x), glm::vec3(1, 0, 0));
+    }
+    if(transform.rotation.y != 0.0){
+        model = glm::rotate(model, glm::radians(transform.rotation.y), glm::vec3(0, 1, 0));
+    }
+    if(transform.rotation.z != 0.0){
+        model = glm::rotate(model, glm::radians(transform.rotation.z), glm::vec3(0, 0, 1));
+    }
+    return glm::scale(model, transform.scale);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include "ecs.hpp"
+#include "components.hpp"
+#include "transforms.hpp"
+#include "jobsystem.hpp"
+
+// Per-frame systems over the entity components. Each one iterates only the components it reads or writes,
+// and chunks are spread across the job system
+namespace Systems{
+    const uint32_t CHUNKS_PER_TASK = 4; // Grain of the chunk loops
+
+    // Moves Transform along Velocity (Transform, Velocity)
+    void integrateVelocities(ECS::World &world, float dtime, JobSystem &jobs);
+
+    // Rebuilds the model matrix and world bounds of the entities whose Transform changed (Transform, ModelMatrix, Bounds)
+    void updateTransforms(ECS::World &world, JobSystem &jobs);
+
+    // Calls func(count, Components *...) on every chunk, CHUNKS_PER_TASK chunks per task
+    template<typename... Components, typename Func>
+    void forEachChunk(const std::vector<ECS::ChunkRef> &chunks, JobSystem &jobs, Func &&func){
+        jobs.parallel_for(static_cast<uint32_t>(chunks.size()), CHUNKS_PER_TASK, [&](uint32_t begin, uint32_t end){
+            for(uint32_t i = begin; i < end; i++){
+                chunks[i].visit<Components...>(func);
+            }
+        });
+    }
+
+    // Helper function building the model matrix of one Transform: translate, rotate X, Y, Z, then scale.
+    // Reference for the batched Transforms kernels used by updateTransforms
+    glm::mat4 computeModelMatrix(const Transform &transform);
+}
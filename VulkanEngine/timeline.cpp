@@ -0,0 +1,80 @@
+#include "timeline.hpp"
+
+void Timeline::create(const vk::raii::Device &logical_device)
+{
+    this -> logical_device = &logical_device;
+
+    vk::SemaphoreTypeCreateInfo type_info(vk::SemaphoreType::eTimeline, 0);
+    vk::SemaphoreCreateInfo semaphore_info;
+    semaphore_info.pNext = &type_info;
+    for(QueueTimeline &queue : queues){
+        queue.semaphore = vk::raii::Semaphore(logical_device, semaphore_info);
+        queue.last_value = 0;
+        queue.completed_value = 0;
+    }
+}
+
+TimelinePoint Timeline::next(QueueType queue)
+{
+    return TimelinePoint{queue, ++get(queue).last_value};
+}
+
+TimelinePoint Timeline::last(QueueType queue) const
+{
+    return TimelinePoint{queue, get(queue).last_value};
+}
+
+vk::SemaphoreSubmitInfo Timeline::signalInfo(TimelinePoint point, vk::PipelineStageFlags2 stages) const
+{
+    return vk::SemaphoreSubmitInfo(*get(point.queue).semaphore, point.value, stages);
+}
+
+vk::SemaphoreSubmitInfo Timeline::waitInfo(TimelinePoint point, vk::PipelineStageFlags2 stages) const
+{
+    return vk::SemaphoreSubmitInfo(*get(point.queue).semaphore, point.value, stages);
+}
+
+bool Timeline::isComplete(TimelinePoint point)
+{
+    QueueTimeline &queue = get(point.queue);
+    if(queue.completed_value < point.value){
+        queue.completed_value = queue.semaphore.getCounterValue();
+    }
+    return queue.completed_value >= point.value;
+}
+
+void Timeline::wait(TimelinePoint point)
+{
+    if(isComplete(point)){
+        return;
+    }
+
+    QueueTimeline &queue = get(point.queue);
+    if(point.value > queue.last_value){
+        throw std::runtime_error("Waiting on a timeline value that was never submitted!");
+    }
+
+    vk::SemaphoreWaitInfo wait_info({}, *queue.semaphore, point.value);
+    while(vk::Result::eTimeout == logical_device -> waitSemaphores(wait_info, UINT64_MAX));
+    queue.completed_value = point.value;
+}
+
+void Timeline::waitIdle()
+{
+    for(size_t i = 0; i < queues.size(); i++){
+        wait(last(static_cast<QueueType>(i)));
+    }
+}
+
+void Timeline::destroy()
+{
+    if(!logical_device){
+        return;
+    }
+
+    waitIdle();
+    for(QueueTimeline &queue : queues){
+        queue.semaphore = nullptr;
+    }
+    logical_device = nullptr;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+// Queues with a timeline of their own
+enum class QueueType : uint32_t{
+    GRAPHICS,
+    TRANSFER,
+    COMPUTE,
+    COUNT
+};
+
+// Moment on the timeline of a queue: reached once the submission that signals value has completed
+struct TimelinePoint{
+    QueueType queue = QueueType::GRAPHICS;
+    uint64_t value = 0; // 0 is reached from the start
+};
+
+/**
+ * GPU clock of the engine: one timeline semaphore per queue, whose value goes up by one with every submission
+ * that signals it. A TimelinePoint names a submission, so the CPU waits on it (frames in flight, uploads),
+ * retired resources are freed once it is reached, and other queues wait on it inside their own submissions.
+ */
+class Timeline{
+public:
+    void create(const vk::raii::Device &logical_device);
+
+    // Reserves the value signaled by the next submission to queue. Submissions must signal in reservation order
+    TimelinePoint next(QueueType queue);
+
+    // Last value reserved on queue: reached when everything submitted so far to it is done
+    TimelinePoint last(QueueType queue) const;
+
+    // Entries of vk::SubmitInfo2 signaling or waiting on point
+    vk::SemaphoreSubmitInfo signalInfo(TimelinePoint point, vk::PipelineStageFlags2 stages) const;
+    vk::SemaphoreSubmitInfo waitInfo(TimelinePoint point, vk::PipelineStageFlags2 stages) const;
+
+    // Non-blocking check. Only queries the driver when the last known value is behind point
+    bool isComplete(TimelinePoint point);
+
+    // Blocks until point is reached
+    void wait(TimelinePoint point);
+
+    // Blocks until every reserved value of every queue is reached
+    void waitIdle();
+
+    void destroy();
+
+private:
+    struct QueueTimeline{
+        vk::raii::Semaphore semaphore = nullptr;
+        uint64_t last_value = 0; // Last reserved
+        uint64_t completed_value = 0; // Last known to be reached
+    };
+
+    const vk::raii::Device * logical_device = nullptr;
+    std::array<QueueTimeline, static_cast<size_t>(QueueType::COUNT)> queues;
+
+    QueueTimeline &get(QueueType queue) { return queues[static_cast<size_t>(queue)]; }
+    const QueueTimeline &get(QueueType queue) const { return queues[static_cast<size_t>(queue)]; }
+};
@@ -0,0 +1,226 @@
+#include "transforms.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TRANSFORMS_X86
+#endif
+
+namespace{
+    const float DEGREES_TO_RADIANS = 0.017453292519943295f;
+
+    // Dispatches the batch to the widest kernel
+    void computeBatch(const Transforms::TRSBatch &batch, float *out, uint32_t stride)
+    {
+        if(Transforms::supportsAVX2()){
+            Transforms::computeModelMatricesAVX2(batch, 0, batch.size(), out, stride);
+        }
+        else{
+            Transforms::computeModelMatricesScalar(batch, 0, batch.size(), out, stride);
+        }
+    }
+}
+
+void Transforms::computeModelMatrices(const TRSBatch &batch, glm::mat4 *out)
+{
+    computeBatch(batch, reinterpret_cast<float *>(out), 16);
+}
+
+void Transforms::computeModelMatrices(const TRSBatch &batch, Affine3x4 *out)
+{
+    computeBatch(batch, reinterpret_cast<float *>(out), 12);
+}
+
+void Transforms::computeModelMatricesScalar(const TRSBatch &batch, uint32_t begin, uint32_t end, float *out, uint32_t stride)
+{
+    for(uint32_t i = begin; i < end; i++, out += stride){
+        float sx = std::sin(batch.rotation_x[i] * DEGREES_TO_RADIANS), cx = std::cos(batch.rotation_x[i] * DEGREES_TO_RADIANS);
+        float sy = std::sin(batch.rotation_y[i] * DEGREES_TO_RADIANS), cy = std::cos(batch.rotation_y[i] * DEGREES_TO_RADIANS);
+        float sz = std::sin(batch.rotation_z[i] * DEGREES_TO_RADIANS), cz = std::cos(batch.rotation_z[i] * DEGREES_TO_RADIANS);
+
+        // Columns of Rx * Ry * Rz, each scaled by its axis
+        float m00 = cy * cz * batch.scale_x[i];
+        float m10 = (sx * sy * cz + cx * sz) * batch.scale_x[i];
+        float m20 = (sx * sz - cx * sy * cz) * batch.scale_x[i];
+        float m01 = -cy * sz * batch.scale_y[i];
+        float m11 = (cx * cz - sx * sy * sz) * batch.scale_y[i];
+        float m21 = (cx * sy * sz + sx * cz) * batch.scale_y[i];
+        float m02 = sy * batch.scale_z[i];
+        float m12 = -sx * cy * batch.scale_z[i];
+        float m22 = cx * cy * batch.scale_z[i];
+
+        if(stride == 16){
+            const float matrix[16] = {
+                m00, m10, m20, 0.f,
+                m01, m11, m21, 0.f,
+                m02, m12, m22, 0.f,
+                batch.position_x[i], batch.position_y[i], batch.position_z[i], 1.f
+            };
+            std::copy(matrix, matrix + 16, out);
+        }
+        else{
+            const float matrix[12] = {
+                m00, m01, m02, batch.position_x[i],
+                m10, m11, m12, batch.position_y[i],
+                m20, m21, m22, batch.position_z[i]
+            };
+            std::copy(matrix, matrix + 12, out);
+        }
+    }
+}
+
+#ifdef TRANSFORMS_X86
+
+namespace{
+    // Sine and cosine of 8 angles in radians (Cephes single precision polynomials on [-pi/4, pi/4])
+    __attribute__((target("avx2,fma")))
+    void sincos8(__m256 x, __m256 &out_sin, __m256 &out_cos)
+    {
+        const __m256 sign_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+        __m256 sign_sin = _mm256_and_ps(x, sign_mask);
+        x = _mm256_andnot_ps(sign_mask, x);
+
+        // Octant of the angle, rounded to even
+        __m256i octant = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(1.27323954473516f))); // 4 / pi
+        octant = _mm256_and_si256(_mm256_add_epi32(octant, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+        __m256 y = _mm256_cvtepi32_ps(octant);
+
+        __m256 swap_sign_sin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(4)), 29));
+        __m256 use_sin_poly = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+        __m256 sign_cos = _mm256_castsi256_ps(_mm256_slli_epi32(
+            _mm256_andnot_si256(_mm256_sub_epi32(octant, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+        sign_sin = _mm256_xor_ps(sign_sin, swap_sign_sin);
+
+        // Extended precision reduction: x - y * pi / 4
+        x = _mm256_fmadd_ps(y, _mm256_set1_ps(-0.78515625f), x);
+        x = _mm256_fmadd_ps(y, _mm256_set1_ps(-2.4187564849853515625e-4f), x);
+        x = _mm256_fmadd_ps(y, _mm256_set1_ps(-3.77489497744594108e-8f), x);
+        __m256 z = _mm256_mul_ps(x, x);
+
+        __m256 cos_poly = _mm256_fmadd_ps(_mm256_set1_ps(2.443315711809948e-5f), z, _mm256_set1_ps(-1.388731625493765e-3f));
+        cos_poly = _mm256_fmadd_ps(cos_poly, z, _mm256_set1_ps(4.166664568298827e-2f));
+        cos_poly = _mm256_mul_ps(_mm256_mul_ps(cos_poly, z), z);
+        cos_poly = _mm256_fmadd_ps(z, _mm256_set1_ps(-0.5f), cos_poly);
+        cos_poly = _mm256_add_ps(cos_poly, _mm256_set1_ps(1.f));
+
+        __m256 sin_poly = _mm256_fmadd_ps(_mm256_set1_ps(-1.9515295891e-4f), z, _mm256_set1_ps(8.3321608736e-3f));
+        sin_poly = _mm256_fmadd_ps(sin_poly, z, _mm256_set1_ps(-1.6666654611e-1f));
+        sin_poly = _mm256_fmadd_ps(_mm256_mul_ps(sin_poly, z), x, x);
+
+        out_sin = _mm256_xor_ps(_mm256_blendv_ps(cos_poly, sin_poly, use_sin_poly), sign_sin);
+        out_cos = _mm256_xor_ps(_mm256_blendv_ps(sin_poly, cos_poly, use_sin_poly), sign_cos);
+    }
+
+    // Angles in degrees to radians, wrapped to [-180, 180] first so the reduction stays exact for large angles
+    __attribute__((target("avx2,fma")))
+    __m256 wrapToRadians(__m256 degrees)
+    {
+        __m256 turns = _mm256_round_ps(_mm256_mul_ps(degrees, _mm256_set1_ps(1.f / 360.f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        degrees = _mm256_fnmadd_ps(turns, _mm256_set1_ps(360.f), degrees);
+        return _mm256_mul_ps(degrees, _mm256_set1_ps(DEGREES_TO_RADIANS));
+    }
+
+    // Rows become columns: out lane i holds element i of every input row
+    __attribute__((target("avx2,fma")))
+    void transpose8x8(const __m256 in[8], __m256 out[8])
+    {
+        __m256 t[8], u[8];
+        for(int i = 0; i < 8; i += 2){
+            t[i] = _mm256_unpacklo_ps(in[i], in[i + 1]);
+            t[i + 1] = _mm256_unpackhi_ps(in[i], in[i + 1]);
+        }
+        for(int i = 0; i < 8; i += 4){
+            u[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+            u[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+            u[i + 2] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+            u[i + 3] = _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+        }
+        for(int i = 0; i < 4; i++){
+            out[i] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x20);
+            out[i + 4] = _mm256_permute2f128_ps(u[i], u[i + 4], 0x31);
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+void Transforms::computeModelMatricesAVX2(const TRSBatch &batch, uint32_t begin, uint32_t end, float *out, uint32_t stride)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.f);
+
+    uint32_t i = begin;
+    for(; i + 8 <= end; i += 8, out += 8 * stride){
+        __m256 sx, cx, sy, cy, sz, cz;
+        sincos8(wrapToRadians(_mm256_loadu_ps(&batch.rotation_x[i])), sx, cx);
+        sincos8(wrapToRadians(_mm256_loadu_ps(&batch.rotation_y[i])), sy, cy);
+        sincos8(wrapToRadians(_mm256_loadu_ps(&batch.rotation_z[i])), sz, cz);
+        __m256 scale_x = _mm256_loadu_ps(&batch.scale_x[i]);
+        __m256 scale_y = _mm256_loadu_ps(&batch.scale_y[i]);
+        __m256 scale_z = _mm256_loadu_ps(&batch.scale_z[i]);
+
+        // Same closed form as the scalar kernel
+        __m256 sx_sy = _mm256_mul_ps(sx, sy);
+        __m256 cx_sy = _mm256_mul_ps(cx, sy);
+        __m256 m00 = _mm256_mul_ps(_mm256_mul_ps(cy, cz), scale_x);
+        __m256 m10 = _mm256_mul_ps(_mm256_fmadd_ps(sx_sy, cz, _mm256_mul_ps(cx, sz)), scale_x);
+        __m256 m20 = _mm256_mul_ps(_mm256_fnmadd_ps(cx_sy, cz, _mm256_mul_ps(sx, sz)), scale_x);
+        __m256 m01 = _mm256_mul_ps(_mm256_mul_ps(cy, sz), _mm256_sub_ps(zero, scale_y));
+        __m256 m11 = _mm256_mul_ps(_mm256_fnmadd_ps(sx_sy, sz, _mm256_mul_ps(cx, cz)), scale_y);
+        __m256 m21 = _mm256_mul_ps(_mm256_fmadd_ps(cx_sy, sz, _mm256_mul_ps(sx, cz)), scale_y);
+        __m256 m02 = _mm256_mul_ps(sy, scale_z);
+        __m256 m12 = _mm256_mul_ps(_mm256_mul_ps(sx, cy), _mm256_sub_ps(zero, scale_z));
+        __m256 m22 = _mm256_mul_ps(_mm256_mul_ps(cx, cy), scale_z);
+        __m256 px = _mm256_loadu_ps(&batch.position_x[i]);
+        __m256 py = _mm256_loadu_ps(&batch.position_y[i]);
+        __m256 pz = _mm256_loadu_ps(&batch.position_z[i]);
+
+        // Matrix elements in memory order, padded to 16 rows for the transposes
+        __m256 elements[16];
+        if(stride == 16){
+            const __m256 column_major[16] = {m00, m10, m20, zero, m01, m11, m21, zero, m02, m12, m22, zero, px, py, pz, one};
+            std::copy(column_major, column_major + 16, elements);
+        }
+        else{
+            const __m256 row_major[16] = {m00, m01, m02, px, m10, m11, m12, py, m20, m21, m22, pz, zero, zero, zero, zero};
+            std::copy(row_major, row_major + 16, elements);
+        }
+
+        __m256 low[8], high[8];
+        transpose8x8(elements, low);
+        transpose8x8(elements + 8, high);
+        for(int lane = 0; lane < 8; lane++){
+            float * matrix = out + lane * stride;
+            _mm256_storeu_ps(matrix, low[lane]);
+            if(stride == 16){
+                _mm256_storeu_ps(matrix + 8, high[lane]);
+            }
+            else{
+                _mm_storeu_ps(matrix + 8, _mm256_castps256_ps128(high[lane]));
+            }
+        }
+    }
+
+    computeModelMatricesScalar(batch, i, end, out, stride);
+}
+
+bool Transforms::supportsAVX2()
+{
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+}
+
+#else
+
+// Non x86 builds only have the scalar kernel
+void Transforms::computeModelMatricesAVX2(const TRSBatch &batch, uint32_t begin, uint32_t end, float *out, uint32_t stride)
+{
+    computeModelMatricesScalar(batch, begin, end, out, stride);
+}
+
+bool Transforms::supportsAVX2()
+{
+    return false;
+}
+
+#endif
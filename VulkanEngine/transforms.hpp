@@ -0,0 +1,53 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+namespace Transforms{
+    // Translation, euler rotation (degrees, applied X then Y then Z) and scale stored as a structure of arrays
+    struct TRSBatch{
+        std::vector<float> position_x, position_y, position_z;
+        std::vector<float> rotation_x, rotation_y, rotation_z;
+        std::vector<float> scale_x, scale_y, scale_z;
+
+        void clear(){
+            for(std::vector<float> * array : arrays()){
+                array -> clear();
+            }
+        }
+
+        void push(const glm::vec3 &position, const glm::vec3 &rotation, const glm::vec3 &scale){
+            position_x.push_back(position.x); position_y.push_back(position.y); position_z.push_back(position.z);
+            rotation_x.push_back(rotation.x); rotation_y.push_back(rotation.y); rotation_z.push_back(rotation.z);
+            scale_x.push_back(scale.x); scale_y.push_back(scale.y); scale_z.push_back(scale.z);
+        }
+
+        uint32_t size() const{
+            return static_cast<uint32_t>(position_x.size());
+        }
+
+    private:
+        std::array<std::vector<float> *, 9> arrays(){
+            return {&position_x, &position_y, &position_z, &rotation_x, &rotation_y, &rotation_z, &scale_x, &scale_y, &scale_z};
+        }
+    };
+
+    // Affine matrix stored as its first three rows, for shaders reading a mat3x4
+    struct Affine3x4{
+        glm::vec4 rows[3];
+    };
+
+    /**
+     * Writes the model matrix of every TRS in the batch, the same matrix as translate * rotateX * rotateY * rotateZ * scale.
+     * The matrix is built in closed form from the sines and cosines of the three angles, so there are no
+     * matrix products. out can point straight into mapped memory. Uses the widest kernel the CPU supports
+     */
+    void computeModelMatrices(const TRSBatch &batch, glm::mat4 *out);
+    void computeModelMatrices(const TRSBatch &batch, Affine3x4 *out);
+
+    // Kernels for the entries in [begin, end). out points at the matrix of entry begin, stride is 16 or 12 floats
+    void computeModelMatricesScalar(const TRSBatch &batch, uint32_t begin, uint32_t end, float *out, uint32_t stride);
+    void computeModelMatricesAVX2(const TRSBatch &batch, uint32_t begin, uint32_t end, float *out, uint32_t stride); // 8 entries at a time
+
+    // Returns whether the AVX2 kernel can run on this CPU
+    bool supportsAVX2();
+}
@@ -0,0 +1,223 @@
+#include "transientallocator.hpp"
+
+namespace{
+    // Usages that keep an image inside the render passes, the only ones lazily allocated memory supports
+    const vk::ImageUsageFlags ATTACHMENT_USAGE = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment |
+                                                 vk::ImageUsageFlagBits::eInputAttachment;
+
+    bool livesTogether(const TransientRequest &a, const TransientRequest &b)
+    {
+        return a.first_pass <= b.last_pass && b.first_pass <= a.last_pass;
+    }
+
+    vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void TransientAllocator::create(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &logical_device, VmaAllocator vma_allocator,
+                                uint32_t frames_in_flight)
+{
+    this -> logical_device = &logical_device;
+    this -> vma_allocator = vma_allocator;
+    frames.resize(frames_in_flight);
+    current_frame = 0;
+
+    vk::PhysicalDeviceMemoryProperties memory_properties = physical_device.getMemoryProperties();
+    lazy_memory_types = 0;
+    for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++){
+        if(memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eLazilyAllocated){
+            lazy_memory_types |= 1u << i;
+        }
+    }
+    std::cout << "Transient attachments: lazily allocated memory " << (lazy_memory_types ? "available" : "not available") << std::endl;
+}
+
+void TransientAllocator::beginFrame(uint32_t frame)
+{
+    current_frame = frame;
+}
+
+const std::vector<TransientImage> &TransientAllocator::allocate(const std::vector<TransientRequest> &requests)
+{
+    FrameImages &frame = frames[current_frame];
+    if(!frame.built || frame.requests != requests){
+        build(frame, requests);
+    }
+    return frame.handles;
+}
+
+void TransientAllocator::destroy()
+{
+    for(FrameImages &frame : frames){
+        release(frame);
+    }
+    frames.clear();
+    logical_device = nullptr;
+    vma_allocator = nullptr;
+}
+
+vk::ImageAspectFlags TransientAllocator::getAspect(vk::Format format)
+{
+    switch(format){
+        case vk::Format::eD16Unorm:
+        case vk::Format::eX8D24UnormPack32:
+        case vk::Format::eD32Sfloat:
+            return vk::ImageAspectFlagBits::eDepth;
+        case vk::Format::eD16UnormS8Uint:
+        case vk::Format::eD24UnormS8Uint:
+        case vk::Format::eD32SfloatS8Uint:
+            return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+        case vk::Format::eS8Uint:
+            return vk::ImageAspectFlagBits::eStencil;
+        default:
+            return vk::ImageAspectFlagBits::eColor;
+    }
+}
+
+void TransientAllocator::build(FrameImages &frame, const std::vector<TransientRequest> &requests)
+{
+    // The frame's previous submission is done, nothing reads the old images anymore
+    release(frame);
+    frame.built = true;
+    frame.requests = requests;
+
+    const size_t count = requests.size();
+    std::vector<vk::MemoryRequirements> requirements(count);
+    std::vector<bool> lazy(count, false);
+    for(size_t i = 0; i < count; i++){
+        const TransientRequest &request = requests[i];
+        const bool attachment_only = request.first_pass == request.last_pass && !(request.desc.usage & ~ATTACHMENT_USAGE);
+
+        vk::ImageCreateInfo image_info{};
+        image_info.imageType = vk::ImageType::e2D;
+        image_info.format = request.desc.format;
+        image_info.extent = vk::Extent3D(request.desc.extent.width, request.desc.extent.height, 1);
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = request.desc.samples;
+        image_info.tiling = vk::ImageTiling::eOptimal; // Optimal images may sit next to each other without a granularity gap
+        image_info.usage = request.desc.usage | (attachment_only && lazy_memory_types ? vk::ImageUsageFlagBits::eTransientAttachment : vk::ImageUsageFlags());
+        image_info.sharingMode = vk::SharingMode::eExclusive;
+        image_info.initialLayout = vk::ImageLayout::eUndefined;
+        frame.images.emplace_back(*logical_device, image_info);
+
+        requirements[i] = frame.images[i].getMemoryRequirements();
+        lazy[i] = attachment_only && (requirements[i].memoryTypeBits & lazy_memory_types);
+        frame.unaliased_size += requirements[i].size;
+    }
+
+    // Largest first, each at the lowest offset not overlapping an image alive at the same time
+    std::vector<size_t> order;
+    for(size_t i = 0; i < count; i++){
+        if(!lazy[i]){
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b){ return requirements[a].size > requirements[b].size; });
+
+    std::vector<vk::DeviceSize> offsets(count, 0);
+    std::vector<size_t> placed;
+    vk::MemoryRequirements heap_requirements(0, 1, ~0u);
+    for(size_t i : order){
+        vk::DeviceSize offset = 0;
+        bool moved = true;
+        while(moved){
+            moved = false;
+            for(size_t other : placed){
+                bool overlaps = offset < offsets[other] + requirements[other].size && offsets[other] < offset + requirements[i].size;
+                if(overlaps && livesTogether(requests[i], requests[other])){
+                    offset = alignUp(offsets[other] + requirements[other].size, requirements[i].alignment);
+                    moved = true;
+                }
+            }
+        }
+        offsets[i] = offset;
+        placed.push_back(i);
+
+        heap_requirements.size = std::max(heap_requirements.size, offset + requirements[i].size);
+        heap_requirements.alignment = std::max(heap_requirements.alignment, requirements[i].alignment);
+        heap_requirements.memoryTypeBits &= requirements[i].memoryTypeBits;
+    }
+
+    if(!placed.empty()){
+        if(heap_requirements.memoryTypeBits == 0){
+            throw std::runtime_error("Transient images share no memory type!");
+        }
+        VmaAllocationCreateInfo alloc_info{};
+        alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+        VkMemoryRequirements temp_requirements = (VkMemoryRequirements)heap_requirements;
+        VmaAllocation heap;
+        if(vmaAllocateMemory(vma_allocator, &temp_requirements, &alloc_info, &heap, nullptr) != VK_SUCCESS){
+            throw std::runtime_error("Failed to allocate the transient image heap!");
+        }
+        frame.allocations.push_back(heap);
+        frame.heap_size = heap_requirements.size;
+
+        for(size_t i : placed){
+            if(vmaBindImageMemory2(vma_allocator, heap, offsets[i], *frame.images[i], nullptr) != VK_SUCCESS){
+                throw std::runtime_error("Failed to bind a transient image!");
+            }
+        }
+    }
+
+    uint32_t lazy_count = 0;
+    for(size_t i = 0; i < count; i++){
+        if(!lazy[i]){
+            continue;
+        }
+        VmaAllocationCreateInfo alloc_info{};
+        alloc_info.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+
+        VmaAllocation allocation;
+        if(vmaAllocateMemoryForImage(vma_allocator, *frame.images[i], &alloc_info, &allocation, nullptr) != VK_SUCCESS){
+            throw std::runtime_error("Failed to allocate lazy memory for a transient image!");
+        }
+        frame.allocations.push_back(allocation);
+        if(vmaBindImageMemory(vma_allocator, allocation, *frame.images[i]) != VK_SUCCESS){
+            throw std::runtime_error("Failed to bind a transient image!");
+        }
+        lazy_count++;
+    }
+
+    for(size_t i = 0; i < count; i++){
+        vk::ImageViewCreateInfo view_info({}, *frame.images[i], vk::ImageViewType::e2D, requests[i].desc.format, {},
+                                          vk::ImageSubresourceRange(getAspect(requests[i].desc.format), 0, 1, 0, 1));
+        frame.views.emplace_back(*logical_device, view_info);
+
+        TransientImage &handle = frame.handles.emplace_back();
+        handle.image = *frame.images[i];
+        handle.view = *frame.views[i];
+        // Images placed before on the same bytes whose passes all come first, the new one must wait for them
+        for(size_t other : placed){
+            if(lazy[i] || lazy[other] || requests[other].last_pass >= requests[i].first_pass){
+                continue;
+            }
+            if(offsets[i] < offsets[other] + requirements[other].size && offsets[other] < offsets[i] + requirements[i].size){
+                handle.aliases.push_back(static_cast<uint32_t>(other));
+            }
+        }
+    }
+
+    std::cout << "Transient images of frame " << current_frame << ": " << count << " images, " << frame.heap_size / 1024 << " KiB heap for "
+              << frame.unaliased_size / 1024 << " KiB of images, " << lazy_count << " lazily allocated" << std::endl;
+}
+
+void TransientAllocator::release(FrameImages &frame)
+{
+    // Views and images go before the memory they are bound to
+    frame.handles.clear();
+    frame.views.clear();
+    frame.images.clear();
+    for(VmaAllocation allocation : frame.allocations){
+        vmaFreeMemory(vma_allocator, allocation);
+    }
+    frame.allocations.clear();
+    frame.requests.clear();
+    frame.heap_size = 0;
+    frame.unaliased_size = 0;
+    frame.built = false;
+}
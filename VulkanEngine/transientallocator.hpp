@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+// What a transient image is made of. usage is gathered from the passes using it
+struct TransientImageDesc{
+    vk::Format format = vk::Format::eUndefined;
+    vk::Extent2D extent;
+    vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+    vk::ImageUsageFlags usage;
+
+    bool operator==(const TransientImageDesc &) const = default;
+};
+
+// A transient image and the passes it lives across, as indices in declaration order
+struct TransientRequest{
+    TransientImageDesc desc;
+    uint32_t first_pass = 0;
+    uint32_t last_pass = 0;
+
+    bool operator==(const TransientRequest &) const = default;
+};
+
+struct TransientImage{
+    vk::Image image = nullptr;
+    vk::ImageView view = nullptr;
+    std::vector<uint32_t> aliases; // Requests living earlier on overlapping memory, all their uses come before the first use of this one
+};
+
+/**
+ * Memory for the images that only live inside one frame of the render graph.
+ * The images of a frame share one heap: each is placed at the lowest offset free of the images its pass range overlaps,
+ * so images that are never alive at the same time alias the same bytes. Images only used as attachments of a single
+ * pass never leave the tile memory on tilers, they get their own lazily allocated memory when the device has such a
+ * type and take no room in the heap. Every frame in flight has its own images, kept as long as the frame asks for the
+ * same requests, so steady frames create nothing.
+ */
+class TransientAllocator{
+public:
+    void create(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &logical_device, VmaAllocator vma_allocator,
+                uint32_t frames_in_flight);
+
+    // Selects the frame in flight served by allocate. Its previous submission must be done, its images are replaced freely
+    void beginFrame(uint32_t frame);
+
+    // One image per request, in order. Valid until the next allocate of the same frame with other requests
+    const std::vector<TransientImage> &allocate(const std::vector<TransientRequest> &requests);
+
+    void destroy();
+
+    // Aspect of a view or barrier covering every plane of format
+    static vk::ImageAspectFlags getAspect(vk::Format format);
+
+    // Memory of the current frame: the aliased heap, and what its images would take one allocation each
+    vk::DeviceSize getHeapSize() const { return frames[current_frame].heap_size; }
+    vk::DeviceSize getUnaliasedSize() const { return frames[current_frame].unaliased_size; }
+
+private:
+    struct FrameImages{
+        bool built = false;
+        std::vector<TransientRequest> requests;
+        std::vector<vk::raii::Image> images;
+        std::vector<vk::raii::ImageView> views;
+        std::vector<TransientImage> handles;
+        std::vector<VmaAllocation> allocations; // The heap, when any image is placed in it, then one per lazily allocated image
+        vk::DeviceSize heap_size = 0;
+        vk::DeviceSize unaliased_size = 0;
+    };
+
+    const vk::raii::Device *logical_device = nullptr;
+    VmaAllocator vma_allocator = nullptr;
+    uint32_t lazy_memory_types = 0; // Bit i set when memory type i is lazily allocated
+    std::vector<FrameImages> frames;
+    uint32_t current_frame = 0;
+
+    void build(FrameImages &frame, const std::vector<TransientRequest> &requests);
+    void release(FrameImages &frame);
+};
@@ -0,0 +1,181 @@
+#include "uploadqueue.hpp"
+#include "cpuprofiler.hpp"
+
+void UploadQueue::create(vk::raii::Device &logical_device, QueuePool &queue_pool, Timeline &timeline, VmaAllocator &vma_allocator)
+{
+    this -> logical_device = &logical_device;
+    this -> queue_pool = &queue_pool;
+    this -> timeline = &timeline;
+    this -> vma_allocator = vma_allocator;
+    last_batch = 0;
+    completed_batch = 0;
+
+    ownership_transfer = queue_pool.transfer_family.value() != queue_pool.graphics_family.value();
+
+    std::cout << "Created Upload Queue, ownership transfer: " << (ownership_transfer ? "yes" : "no") << std::endl;
+}
+
+UploadTicket UploadQueue::uploadBuffer(const void *data, vk::DeviceSize size, AllocatedBuffer &destination, vk::DeviceSize dst_offset,
+                                       vk::PipelineStageFlags2 dst_stage, vk::AccessFlags2 dst_access)
+{
+    if(size == 0){
+        return UploadTicket{last_batch};
+    }
+    if(dst_offset + size > destination.size){
+        throw std::runtime_error("Upload out of the bounds of buffer: " + destination.name);
+    }
+
+    // Copies can start at any offset, 16 bytes keeps every element type aligned
+    vk::DeviceSize src_offset = (staging_data.size() + 15) & ~vk::DeviceSize(15);
+    staging_data.resize(src_offset + size);
+    memcpy(staging_data.data() + src_offset, data, (size_t)size);
+
+    pending_copies.push_back(PendingCopy{destination.buffer, src_offset, dst_offset, size, dst_stage, dst_access});
+
+    return UploadTicket{last_batch + 1};
+}
+
+UploadTicket UploadQueue::flush()
+{
+    PROFILE_ZONE("upload flush");
+    collect();
+    if(pending_copies.empty()){
+        return UploadTicket{last_batch};
+    }
+
+    Batch batch;
+    batch.number = last_batch + 1;
+    batch.staging_buffer = Device::createBuffer(staging_data.size(), vk::BufferUsageFlagBits::eTransferSrc,
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, "upload staging buffer", vma_allocator);
+    memcpy(batch.staging_buffer.info.pMappedData, staging_data.data(), staging_data.size());
+
+    uint32_t transfer_family = queue_pool -> transfer_family.value();
+    uint32_t graphics_family = queue_pool -> graphics_family.value();
+
+    // Release barriers (transfer side) and acquire barriers (graphics side) must describe the same ranges
+    std::vector<vk::BufferMemoryBarrier2> release_barriers;
+    std::vector<vk::BufferMemoryBarrier2> acquire_barriers;
+    vk::PipelineStageFlags2 dst_stages;
+    vk::AccessFlags2 dst_accesses;
+    for(const PendingCopy &copy : pending_copies){
+        dst_stages |= copy.dst_stage;
+        dst_accesses |= copy.dst_access;
+        if(!ownership_transfer){
+            continue;
+        }
+
+        vk::BufferMemoryBarrier2 barrier{};
+        barrier.srcQueueFamilyIndex = transfer_family;
+        barrier.dstQueueFamilyIndex = graphics_family;
+        barrier.buffer = copy.destination;
+        barrier.offset = copy.dst_offset;
+        barrier.size = copy.size;
+
+        barrier.srcStageMask = vk::PipelineStageFlagBits2::eTransfer;
+        barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+        release_barriers.push_back(barrier);
+
+        barrier.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+        barrier.srcAccessMask = vk::AccessFlagBits2::eNone;
+        barrier.dstStageMask = copy.dst_stage;
+        barrier.dstAccessMask = copy.dst_access;
+        acquire_barriers.push_back(barrier);
+    }
+
+    // TRANSFER SUBMISSION
+    batch.transfer_command_buffer = Device::beginSingleTimeCommands(queue_pool -> transfer_command_pool, *logical_device);
+    for(const PendingCopy &copy : pending_copies){
+        batch.transfer_command_buffer.copyBuffer(batch.staging_buffer.buffer, copy.destination, vk::BufferCopy(copy.src_offset, copy.dst_offset, copy.size));
+    }
+    if(ownership_transfer){
+        vk::DependencyInfo dependency_info{};
+        dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(release_barriers.size());
+        dependency_info.pBufferMemoryBarriers = release_barriers.data();
+        batch.transfer_command_buffer.pipelineBarrier2(dependency_info);
+    }
+    else{
+        // Same queue as graphics: later submissions are ordered, the writes only need to be made visible
+        Device::memoryBarrier(batch.transfer_command_buffer, vk::PipelineStageFlagBits2::eTransfer, vk::AccessFlagBits2::eTransferWrite,
+                              dst_stages, dst_accesses);
+    }
+    batch.transfer_command_buffer.end();
+
+    TimelinePoint copies_done = timeline -> next(QueueType::TRANSFER);
+    vk::CommandBufferSubmitInfo transfer_command_info(*batch.transfer_command_buffer);
+    vk::SemaphoreSubmitInfo transfer_signal_info = timeline -> signalInfo(copies_done, vk::PipelineStageFlagBits2::eAllTransfer);
+    vk::SubmitInfo2 transfer_submit_info({}, {}, transfer_command_info, transfer_signal_info);
+    queue_pool -> transfer_queue.submit2(transfer_submit_info, nullptr);
+    batch.done = copies_done;
+
+    // GRAPHICS ACQUIRE SUBMISSION: waits for the copies, later graphics submissions are ordered after its barriers
+    if(ownership_transfer){
+        batch.acquire_command_buffer = Device::beginSingleTimeCommands(queue_pool -> graphics_command_pool, *logical_device);
+        vk::DependencyInfo dependency_info{};
+        dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(acquire_barriers.size());
+        dependency_info.pBufferMemoryBarriers = acquire_barriers.data();
+        batch.acquire_command_buffer.pipelineBarrier2(dependency_info);
+        batch.acquire_command_buffer.end();
+
+        batch.done = timeline -> next(QueueType::GRAPHICS);
+        vk::SemaphoreSubmitInfo acquire_wait_info = timeline -> waitInfo(copies_done, dst_stages);
+        vk::CommandBufferSubmitInfo acquire_command_info(*batch.acquire_command_buffer);
+        vk::SemaphoreSubmitInfo acquire_signal_info = timeline -> signalInfo(batch.done, vk::PipelineStageFlagBits2::eAllCommands);
+        vk::SubmitInfo2 acquire_submit_info({}, acquire_wait_info, acquire_command_info, acquire_signal_info);
+        queue_pool -> graphics_queue.submit2(acquire_submit_info, nullptr);
+    }
+
+    std::cout << "Submitted upload batch " << batch.number << ": " << pending_copies.size() << " copies, " << staging_data.size() << " bytes" << std::endl;
+
+    last_batch = batch.number;
+    batches.push_back(std::move(batch));
+    pending_copies.clear();
+    staging_data.clear();
+
+    return UploadTicket{last_batch};
+}
+
+bool UploadQueue::isComplete(UploadTicket ticket)
+{
+    collect();
+    return completed_batch >= ticket.batch;
+}
+
+void UploadQueue::wait(UploadTicket ticket)
+{
+    if(ticket.batch > last_batch){
+        throw std::runtime_error("Waiting on an upload that was never flushed!");
+    }
+
+    collect();
+    if(completed_batch >= ticket.batch){
+        return; // Already done, later batches must not be waited on
+    }
+    for(const Batch &batch : batches){
+        if(batch.number == ticket.batch){
+            timeline -> wait(batch.done);
+            break;
+        }
+    }
+    collect();
+}
+
+void UploadQueue::destroy()
+{
+    if(timeline == nullptr){
+        return;
+    }
+
+    wait(UploadTicket{last_batch});
+    batches.clear();
+    pending_copies.clear();
+    staging_data.clear();
+    timeline = nullptr;
+}
+
+void UploadQueue::collect()
+{
+    while(!batches.empty() && timeline -> isComplete(batches.front().done)){
+        completed_batch = batches.front().number;
+        batches.pop_front();
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "../Helpers/GeneralLibraries.hpp"
+
+#include "device.hpp"
+#include "timeline.hpp"
+
+// Handle to a queued upload: the batch it is submitted with. Batches complete in order
+struct UploadTicket{
+    uint64_t batch = 0;
+};
+
+/**
+ * Batched uploads on the transfer queue.
+ * Copies are queued on the CPU and submitted together by flush(), which signals the transfer timeline instead of
+ * waiting for the queue to be idle. When the transfer family is not the graphics one, the destination buffers are
+ * released by the transfer queue and acquired by the graphics queue, which waits on the transfer timeline.
+ * Graphics work submitted after flush() can use the uploaded buffers without any CPU wait.
+ */
+class UploadQueue{
+public:
+    // The queues and command pools of queue_pool must already exist. Submissions signal timeline
+    void create(vk::raii::Device &logical_device, QueuePool &queue_pool, Timeline &timeline, VmaAllocator &vma_allocator);
+
+    // Queues a copy of size bytes from data to destination at dst_offset. data is copied right away and can be freed.
+    // dst_stage and dst_access describe the first graphics use of the buffer
+    UploadTicket uploadBuffer(const void *data, vk::DeviceSize size, AllocatedBuffer &destination, vk::DeviceSize dst_offset,
+                              vk::PipelineStageFlags2 dst_stage, vk::AccessFlags2 dst_access);
+
+    // Submits every queued copy with a single submission. Returns the ticket of the batch
+    UploadTicket flush();
+
+    // Non-blocking check of a ticket. Also frees the resources of the finished batches
+    bool isComplete(UploadTicket ticket);
+
+    // Blocks until the ticket is complete
+    void wait(UploadTicket ticket);
+
+    // Waits for every batch and releases the resources. Needed before destroying the allocator
+    void destroy();
+
+private:
+    struct PendingCopy{
+        vk::Buffer destination;
+        vk::DeviceSize src_offset;
+        vk::DeviceSize dst_offset;
+        vk::DeviceSize size;
+        vk::PipelineStageFlags2 dst_stage;
+        vk::AccessFlags2 dst_access;
+    };
+
+    // Resources of a submitted batch, kept alive until done is reached
+    struct Batch{
+        uint64_t number = 0;
+        TimelinePoint done; // Graphics acquire when there is one, copies otherwise
+        AllocatedBuffer staging_buffer;
+        vk::raii::CommandBuffer transfer_command_buffer = nullptr;
+        vk::raii::CommandBuffer acquire_command_buffer = nullptr;
+    };
+
+    vk::raii::Device * logical_device = nullptr;
+    QueuePool * queue_pool = nullptr;
+    VmaAllocator vma_allocator = nullptr;
+
+    Timeline * timeline = nullptr;
+    uint64_t last_batch = 0; // Number of the last submitted batch
+    uint64_t completed_batch = 0; // Every batch up to this one is done
+
+    std::vector<char> staging_data; // Data of the queued copies, moved to a staging buffer by flush()
+    std::vector<PendingCopy> pending_copies;
+    std::deque<Batch> batches; // Submitted batches, oldest first
+
+    bool ownership_transfer = false; // Transfer and graphics families differ
+
+    // Frees the batches the GPU is done with
+    void collect();
+};
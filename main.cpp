@@ -1,5 +1,8 @@
 #include "scene.hpp"
 
+#include <charconv>
+#include <cstring>
+
 int main(int argc, char * argv[]){
     Scene engine;
 
@@ -7,9 +10,40 @@ int main(int argc, char * argv[]){
     // Extracting title from input
     const std::string title = argv[1];
 
-    // Extracting dimensions from input
+    // Extracting dimensions and options from input
+    size_t dimension_index = 0;
     for(size_t i = 2; i < argc; ++i){
-        dimensions[i-2] = std::atoi(argv[i]);
+        const std::string arg = argv[i];
+
+        // --headless <frames> [readback.ppm]: render offscreen, no window needed
+        if(arg == "--headless"){
+            uint32_t frames = (i + 1 < argc && argv[i + 1][0] != '-') ? std::atoi(argv[++i]) : 100;
+            std::string readback_path = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "";
+            engine.setHeadless(frames, readback_path);
+        }
+        // --profile [trace.json]: CPU profiler on, Chrome trace written at exit and on P
+        else if(arg == "--profile"){
+            std::string trace_path = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "trace.json";
+            engine.setProfiling(trace_path);
+        }
+        // --fps <n> [--align-present]: frame rate cap, optionally snapped to the display refresh
+        else if(arg == "--fps"){
+            const char * value = (i + 1 < argc) ? argv[++i] : "";
+            uint32_t fps = 0;
+            auto [end, error] = std::from_chars(value, value + std::strlen(value), fps);
+            if(error != std::errc() || *end != '\0' || fps == 0){
+                std::cerr << "--fps expects a positive frame rate, got \"" << value << "\"" << std::endl;
+                return EXIT_FAILURE;
+            }
+            bool align_present = (i + 1 < argc) && std::string(argv[i + 1]) == "--align-present";
+            if(align_present){
+                i++;
+            }
+            engine.setFrameRate(fps, align_present);
+        }
+        else if(dimension_index < dimensions.size()){
+            dimensions[dimension_index++] = std::atoi(argv[i]);
+        }
     }
 
     engine.init(title, dimensions[0], dimensions[1]);
@@ -19,58 +19,7 @@ public:
         this -> jump_force = jump_force;
         this -> gravity_force = gravity_force;
 
-        vertices = {
-            // FRONT FACE (Normal 0, 0, 1)
-            {glm::vec3(-0.5, 0.5, 0.5), glm::vec3(0, 0, 1), glm::vec3(0.5)}, // TL
-            {glm::vec3(0.5, 0.5, 0.5),  glm::vec3(0, 0, 1), glm::vec3(0.5)}, // TR
-            {glm::vec3(0.5, -0.5, 0.5), glm::vec3(0, 0, 1), glm::vec3(0.5)}, // BR
-            {glm::vec3(-0.5, -0.5, 0.5),glm::vec3(0, 0, 1), glm::vec3(0.5)}, // BL
-
-            // BACK FACE (Normal 0, 0, -1)
-            {glm::vec3(0.5, 0.5, -0.5),  glm::vec3(0, 0, -1), glm::vec3(0.5)}, // TL
-            {glm::vec3(-0.5, 0.5, -0.5), glm::vec3(0, 0, -1), glm::vec3(0.5)}, // TR
-            {glm::vec3(-0.5, -0.5, -0.5),glm::vec3(0, 0, -1), glm::vec3(0.5)}, // BR
-            {glm::vec3(0.5, -0.5, -0.5), glm::vec3(0, 0, -1), glm::vec3(0.5)}, // BL
-
-            // RIGHT FACE (Normal 1, 0, 0)
-            {glm::vec3(0.5, 0.5, 0.5),  glm::vec3(1, 0, 0), glm::vec3(0.5)}, // TL
-            {glm::vec3(0.5, 0.5, -0.5), glm::vec3(1, 0, 0), glm::vec3(0.5)}, // TR
-            {glm::vec3(0.5, -0.5, -0.5),glm::vec3(1, 0, 0), glm::vec3(0.5)}, // BR
-            {glm::vec3(0.5, -0.5, 0.5), glm::vec3(1, 0, 0), glm::vec3(0.5)}, // BL
-
-            // LEFT FACE (Normal -1, 0, 0)
-            {glm::vec3(-0.5, 0.5, -0.5), glm::vec3(-1, 0, 0), glm::vec3(0.5)}, // TL
-            {glm::vec3(-0.5, 0.5, 0.5),  glm::vec3(-1, 0, 0), glm::vec3(0.5)}, // TR
-            {glm::vec3(-0.5, -0.5, 0.5), glm::vec3(-1, 0, 0), glm::vec3(0.5)}, // BR
-            {glm::vec3(-0.5, -0.5, -0.5),glm::vec3(-1, 0, 0), glm::vec3(0.5)}, // BL
-
-            // TOP FACE (Normal 0, 1, 0)
-            {glm::vec3(-0.5, 0.5, -0.5), glm::vec3(0, 1, 0), glm::vec3(0.5)}, // TL
-            {glm::vec3(0.5, 0.5, -0.5),  glm::vec3(0, 1, 0), glm::vec3(0.5)}, // TR
-            {glm::vec3(0.5, 0.5, 0.5),   glm::vec3(0, 1, 0), glm::vec3(0.5)}, // BR
-            {glm::vec3(-0.5, 0.5, 0.5),  glm::vec3(0, 1, 0), glm::vec3(0.5)}, // BL
-
-            // BOTTOM FACE (Normal 0, -1, 0)
-            {glm::vec3(-0.5, -0.5, 0.5), glm::vec3(0, -1, 0), glm::vec3(0.5)}, // TL
-            {glm::vec3(0.5, -0.5, 0.5),  glm::vec3(0, -1, 0), glm::vec3(0.5)}, // TR
-            {glm::vec3(0.5, -0.5, -0.5), glm::vec3(0, -1, 0), glm::vec3(0.5)}, // BR
-            {glm::vec3(-0.5, -0.5, -0.5),glm::vec3(0, -1, 0), glm::vec3(0.5)}, // BL
-        };
-
-        indices = {
-            // Front
-            0, 1, 2,  0, 2, 3,
-            // Back
-            4, 5, 6,  4, 6, 7,
-            // Right
-            8, 9, 10, 8, 10, 11,
-            // Left
-            12, 13, 14, 12, 14, 15,
-            // Top
-            16, 17, 18, 16, 18, 19,
-            // Bottom
-            20, 21, 22, 20, 22, 23
-        };
+        mesh_data = Meshes::cube(glm::vec3(0.5f));
     }
     ~Player() = default;
 
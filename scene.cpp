@@ -4,62 +4,18 @@ void Scene::createInitResources()
 {
     // Setting up the player
     player = Player();
-    player.start(vma_allocator, logical_device, queue_pool);
-
-    ubo_player_mapped.clear();
-    ubo_player_mapped.resize(queue_pool.max_frames_in_flight);
-    vk::DeviceSize player_buffer_size = sizeof(UniformBufferGameObjects);
-
-    for(size_t i = 0; i < queue_pool.max_frames_in_flight; i++){
-        ubo_player_mapped[i].buffer = Device::createBuffer(
-            player_buffer_size,
-            vk::BufferUsageFlagBits::eUniformBuffer,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-            "Player Buffer",
-            vma_allocator
-        );
-        vmaMapMemory(vma_allocator, ubo_player_mapped[i].buffer.allocation, &ubo_player_mapped[i].data);
-    }
+    player.start(mesh_registry);
 
     // Setting up the environment
     ground = Plane(glm::vec3(0.0f), 10.f, 10.f, glm::vec3(90.f, 0.f, 0.f));
-    ground.start(vma_allocator, logical_device, queue_pool);
+    ground.start(mesh_registry);
     current_env_objs++;
 
-    ubo_environment_mapped.clear();
-    ubo_environment_mapped.resize(MAX_ENV_OBJS);
-    vk::DeviceSize env_buffer_size = sizeof(UniformBufferGameObjects);
-    for(size_t i = 0; i < MAX_ENV_OBJS; i++){
-        ubo_environment_mapped[i].clear();
-        ubo_environment_mapped[i].resize(queue_pool.max_frames_in_flight);
-        for(size_t j = 0; j < queue_pool.max_frames_in_flight; j++){
-            ubo_environment_mapped[i][j].buffer = Device::createBuffer(
-                env_buffer_size,
-                vk::BufferUsageFlagBits::eUniformBuffer,
-                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-                "Env obj Buffer",
-                vma_allocator
-            );
-            vmaMapMemory(vma_allocator, ubo_environment_mapped[i][j].buffer.allocation, &ubo_environment_mapped[i][j].data);
-        }
-    }
-
+    // One submission for every object, drawing is ordered after it on the GPU
+    upload_queue.flush();
 
-    // CAMERA RESOURCES SETUP
-    ubo_camera_mapped.clear();
-    ubo_camera_mapped.resize(queue_pool.max_frames_in_flight);
-    vk::DeviceSize camera_buffer_size = sizeof(UniformBufferCamera);
-
-    for(size_t i = 0; i < queue_pool.max_frames_in_flight; i++){
-        ubo_camera_mapped[i].buffer = Device::createBuffer(
-            camera_buffer_size,
-            vk::BufferUsageFlagBits::eUniformBuffer,
-            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-            "Camera Buffer",
-            vma_allocator
-        );
-        vmaMapMemory(vma_allocator, ubo_camera_mapped[i].buffer.allocation, &ubo_camera_mapped[i].data);
-    }
+    // PER-FRAME DATA SETUP: camera, then the player first and the environment after it
+    createFrameAllocator(1 + MAX_ENV_OBJS);
 
     camera = Camera(glm::vec3(0, 0, 2));
 
@@ -69,63 +25,11 @@ void Scene::createInitResources()
     const std::string vertex_shader_path = "Shaders/Samples/vertex.vert.spv";
     const std::string fragment_shader_path = "Shaders/Samples/fragment.frag.spv";
 
-    std::vector<vk::DescriptorSetLayoutBinding> bindings = {
-        // Binding 0: Camera Uniform Object
-        vk::DescriptorSetLayoutBinding(
-            0, // binding location
-            vk::DescriptorType::eUniformBuffer, // Type of binding
-            1, // binding count
-            vk::ShaderStageFlagBits::eVertex,
-            nullptr
-        ),
-
-        // Binding 1: GameObject Uniform Buffer
-        vk::DescriptorSetLayoutBinding(
-            1,
-            vk::DescriptorType::eUniformBuffer,
-            1,
-            vk::ShaderStageFlagBits::eVertex,
-            nullptr
-        ),
-
-        // Biding 2: Environment Uniform Buffers
-        vk::DescriptorSetLayoutBinding(
-            1,
-            vk::DescriptorType::eUniformBuffer,
-            MAX_ENV_OBJS,
-            vk::ShaderStageFlagBits::eVertex,
-            nullptr
-        )
-    };
-    std::string name = "dumb pipeline";
-
-    pipeline_builder.set_name(name);
-    pipeline_builder.add_shader(vertex_shader_path, vk::ShaderStageFlagBits::eVertex, logical_device);
-    pipeline_builder.add_shader(fragment_shader_path, vk::ShaderStageFlagBits::eFragment, logical_device);
-    pipeline_builder.set_topology(vk::PrimitiveTopology::eTriangleList);
-    pipeline_builder.set_rasterizer(vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise, vk::PolygonMode::eFill);
-    pipeline_builder.set_multisampling_none();
-    pipeline_builder.add_non_blend_color_attachment(vk::ColorComponentFlagBits::eR | 
-                                                    vk::ColorComponentFlagBits::eG | 
-                                                    vk::ColorComponentFlagBits::eB | 
-                                                    vk::ColorComponentFlagBits::eA);
-    pipeline_builder.set_color_and_depth_format({swapchain.format}, Image::findDepthFormat(physical_device));
-    pipeline_builder.set_depth_stencil(true, true, vk::CompareOp::eLess);
-
-    main_pipeline = pipeline_builder.build(&bindings, logical_device);
-    
-    main_pipeline.descriptor_pool = PipelineBuilder::createDescriptorPool(bindings, logical_device, queue_pool.max_frames_in_flight);
-    main_pipeline.descriptor_sets = PipelineBuilder::createDescriptorSets(main_pipeline.descriptor_set_layout,
-                                                                        main_pipeline.descriptor_pool,
-                                                                        logical_device,
-                                                                        queue_pool.max_frames_in_flight);
-    std::vector<void *> resources{
-        &ubo_camera_mapped,
-        &ubo_player_mapped,
-        &ubo_environment_mapped
-    };
-    PipelineBuilder::writeDescriptorSets(main_pipeline.descriptor_sets, bindings, resources, logical_device, queue_pool.max_frames_in_flight);
-
+    // Camera, player and environment matrices are read through device addresses. Kept as raster pipeline 0, so the
+    // engine's shader reloads (R, V for the depth view variant) swap it in the background
+    configureRasterPipeline("dumb pipeline", vertex_shader_path, fragment_shader_path);
+    raster_pipelines.push_back(pipeline_builder.build(nullptr, logical_device));
+    pipeline_tickets.emplace_back();
 }
 
 void Scene::updateUniformBuffers(float dtime, int current_frame)
@@ -135,81 +39,95 @@ void Scene::updateUniformBuffers(float dtime, int current_frame)
     ubo_camera.view = camera.getViewMatrix();
     ubo_camera.proj = camera.getProjectionMatrix(swapchain.extent.width * 1.f / swapchain.extent.height);
 
-    memcpy(ubo_camera_mapped[current_frame].data, &ubo_camera, sizeof(UniformBufferCamera));
+    frame_allocator.beginFrame(current_frame);
+
+    FrameAllocation camera_allocation = frame_allocator.allocate(sizeof(UniformBufferCamera));
+    memcpy(camera_allocation.data, &ubo_camera, sizeof(UniformBufferCamera));
 
-    memcpy(ubo_player_mapped[current_frame].data, &player.getUBO(), sizeof(UniformBufferGameObjects));
+    FrameAllocation objects_allocation = frame_allocator.allocate(objects_buffer_info.range);
+    glm::mat4 * models = static_cast<glm::mat4 *>(objects_allocation.data);
+    models[0] = player.getModelMat();
+    models[1] = ground.getModelMat();
+
+    draw_constants = {frame_buffer_address + camera_allocation.offset, frame_buffer_address + objects_allocation.offset};
 }
 
 void Scene::recordCommandBuffer(uint32_t image_index)
 {
     vk::raii::CommandBuffer &command_buffer = queue_pool.graphics_command_buffers[current_frame];
     command_buffer.begin({});
-
-    Image::transitionImageLayout(swapchain.images[image_index], 
-            vk::ImageLayout::eUndefined,
-		    vk::ImageLayout::eColorAttachmentOptimal,
-		    {},                                                        // srcAccessMask (no need to wait for previous operations)
-		    vk::AccessFlagBits2::eColorAttachmentWrite,                // dstAccessMask
-		    vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // srcStage
-		    vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // dstStage
-            vk::ImageAspectFlagBits::eColor,
-            command_buffer
-    );
-    vk::ClearValue  clear_color = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
-
-    vk::RenderingAttachmentInfo attachment_info{};
-    attachment_info.imageView = swapchain.image_views[image_index];
-    attachment_info.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
-    attachment_info.loadOp = vk::AttachmentLoadOp::eClear;
-    attachment_info.storeOp = vk::AttachmentStoreOp::eStore;
-    attachment_info.clearValue = clear_color;
-
-    vk::RenderingInfo rendering_info{};
-    rendering_info.renderArea.offset = vk::Offset2D{0, 0};
-    rendering_info.renderArea.extent = swapchain.extent;
-    rendering_info.layerCount = 1;
-    rendering_info.colorAttachmentCount = 1;
-    rendering_info.pColorAttachments = &attachment_info;
-
-    command_buffer.beginRendering(rendering_info);
-    command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(swapchain.extent.width), static_cast<float>(swapchain.extent.height), 0.0f, 1.0f)); // What portion of the window to use
-    command_buffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), swapchain.extent)); // What portion of the image to use
-    
-    command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, *(main_pipeline.pipeline));
-    command_buffer.setCullMode(main_pipeline.rasterizer.cullMode);
-    command_buffer.bindDescriptorSets(
-        vk::PipelineBindPoint::eGraphics,
-        main_pipeline.layout,
-        0,
-        *main_pipeline.descriptor_sets[current_frame],
-        {}
-    );
-    UniformBufferGameObjects ubo_obj;
-    command_buffer.bindVertexBuffers(0, player.getVertexBuffer(), {0});
-    command_buffer.bindIndexBuffer(player.getIndexBuffer(), 0, vk::IndexType::eUint32);
-    command_buffer.drawIndexed(player.getIndexSize(), 1, 0, 0, 0);
-    
-    command_buffer.endRendering();
-
-    // After rendering, transition the swapchain image to PRESENT_SRC
-    Image::transitionImageLayout(
-        swapchain.images[image_index],
-        vk::ImageLayout::eColorAttachmentOptimal,
-        vk::ImageLayout::ePresentSrcKHR,
-        vk::AccessFlagBits2::eColorAttachmentWrite,                // srcAccessMask
-        {},                                                        // dstAccessMask
-        vk::PipelineStageFlagBits2::eColorAttachmentOutput,        // srcStage
-        vk::PipelineStageFlagBits2::eBottomOfPipe,                 // dstStage
-        vk::ImageAspectFlagBits::eColor,
-        command_buffer
-    );
+    gpu_profiler.beginFrame(command_buffer, current_frame);
+    uint32_t frame_zone = gpu_profiler.beginZone(command_buffer, "frame");
+
+    // Undefined after the acquire, left for the presentation engine (TRANSFER_SRC when headless)
+    render_graph.reset();
+    ResourceHandle target = render_graph.importImage("render target", swapchain.images[image_index], vk::ImageAspectFlagBits::eColor, 1, 1,
+        ImageState{vk::ImageLayout::eUndefined, vk::PipelineStageFlagBits2::eColorAttachmentOutput, vk::AccessFlagBits2::eNone},
+        target_final_state);
+    ResourceHandle frame_data = render_graph.importBuffer("frame data", frame_allocator.getBuffer().buffer);
+    // Transient depth, see Engine::recordCommandBuffer
+    transient_allocator.beginFrame(current_frame);
+    ResourceHandle depth = render_graph.createImage("depth", depth_format, swapchain.extent, msaa_samples);
+
+    render_graph.addPass("rendering")
+        .read(frame_data, ResourceUsage::VERTEX_READ)
+        .write(target, ResourceUsage::COLOR_ATTACHMENT)
+        .write(depth, ResourceUsage::DEPTH_ATTACHMENT)
+        .setExecute([this, image_index, depth](vk::raii::CommandBuffer &command_buffer){
+            vk::ClearValue  clear_color = vk::ClearColorValue(0.0f, 0.0f, 0.0f, 1.0f);
+
+            vk::RenderingAttachmentInfo attachment_info{};
+            attachment_info.imageView = swapchain.image_views[image_index];
+            attachment_info.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+            attachment_info.loadOp = vk::AttachmentLoadOp::eClear;
+            attachment_info.storeOp = vk::AttachmentStoreOp::eStore;
+            attachment_info.clearValue = clear_color;
+
+            vk::RenderingAttachmentInfo depth_info{};
+            depth_info.imageView = render_graph.getImageView(depth);
+            depth_info.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+            depth_info.loadOp = vk::AttachmentLoadOp::eClear;
+            depth_info.storeOp = vk::AttachmentStoreOp::eDontCare;
+            depth_info.clearValue = vk::ClearDepthStencilValue(1.0f, 0);
+
+            vk::RenderingInfo rendering_info{};
+            rendering_info.renderArea.offset = vk::Offset2D{0, 0};
+            rendering_info.renderArea.extent = swapchain.extent;
+            rendering_info.layerCount = 1;
+            rendering_info.colorAttachmentCount = 1;
+            rendering_info.pColorAttachments = &attachment_info;
+            rendering_info.pDepthAttachment = &depth_info;
+
+            rendering_info.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers; // Draws are recorded by the workers
+
+            command_buffer.beginRendering(rendering_info);
+            recordSecondaryDraws(command_buffer, 1, [this](vk::raii::CommandBuffer &draw_buffer, uint32_t begin, uint32_t end){
+                const RasterPipelineBundle &main_pipeline = raster_pipelines[0];
+                const vk::raii::Pipeline *pipeline = getDrawPipeline(0);
+                if(!pipeline){
+                    return;
+                }
+                draw_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, **pipeline);
+                draw_buffer.setCullMode(main_pipeline.rasterizer.cullMode);
+                draw_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, main_pipeline.layout, 0, descriptor_heap.getSet(), nullptr);
+                draw_buffer.pushConstants<DrawPushConstants>(main_pipeline.layout, vk::ShaderStageFlagBits::eVertex, 0, draw_constants);
+                geometry.bind(draw_buffer);
+                const MeshRange &player_mesh = player.getMesh().getRange();
+                draw_buffer.drawIndexed(player_mesh.index_count, 1, player_mesh.first_index, player_mesh.vertex_offset, 0); // firstInstance 0 -> player matrix
+            });
+            command_buffer.endRendering();
+        });
+
+    // Barriers and layout transitions are derived from the declared usages
+    render_graph.execute(command_buffer, &gpu_profiler);
+
+    gpu_profiler.endZone(command_buffer, frame_zone);
     command_buffer.end();
-
-    glfwSetWindowTitle(window, std::to_string(1000.0/time).c_str());
 }
 
 void Scene::processInput()
 {
+    Engine::processInput();
 }
 
 
@@ -218,14 +136,38 @@ void Scene::processInput()
 void Scene::cleanup()
 {
     std::cout << "\nCLEANING UP RESOURCES..." << std::endl;
-    ubo_player_mapped.clear();
+    if(!trace_path.empty()){
+        Profiler::writeChromeTrace(trace_path);
+    }
+    frame_pacer.printReport();
+    gpu_profiler.printReport();
+    gpu_profiler.writeCSV(GPU_TIMINGS_PATH);
+    gpu_profiler.destroy();
+    pipeline_compiler.destroy();
+    pipeline_tickets.clear();
+    retired_pipelines.clear();
+    pipeline_cache.save(pipeline_builder.get_creation_time());
+    pipeline_cache.destroy();
+    shader_library.destroy();
+    descriptor_heap.destroy();
+
+    upload_queue.destroy();
+    timeline.destroy();
     player = {};
+    mesh_registry.destroy();
+    geometry.destroy();
+
+    frame_allocator.destroy();
 
-    ubo_camera_mapped.clear();
+    // Headless views point at color_image, drop them first
+    if(headless){
+        swapchain.image_views.clear();
+    }
 
     // Destroying the images -> this is needed since we need to destroy the allocator
+    retired_swapchains.clear();
     color_image.~AllocatedImage();
-    depth_image.~AllocatedImage();
+    transient_allocator.destroy();
 
     vmaDestroyAllocator(vma_allocator);
 }
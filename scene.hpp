@@ -11,18 +11,13 @@ public:
     void cleanup() override;
 
 private:
-    // Main pipeline
-    RasterPipelineBundle main_pipeline;
-
-    // Player related variables
+    // Player related variables (instance 0 of the object storage buffer)
     Player player;
-    std::vector<MappedUBO> ubo_player_mapped;
 
-    // Variables related to the environment
+    // Variables related to the environment (instances 1 to MAX_ENV_OBJS of the object storage buffer)
     const uint32_t MAX_ENV_OBJS = 100;
     uint32_t current_env_objs = 0;
     Plane ground;
-    std::vector<std::vector<MappedUBO>> ubo_environment_mapped;
 
 
     // Camera variables